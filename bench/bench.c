@@ -0,0 +1,352 @@
+/*
+ * Standalone benchmark of the native decoders
+ * Build and run it by `rake bench`. See `bench -h` for options.
+ *
+ * Every format is measured on synthetic data (random blocks; only legal blocks for ASTC).
+ * Recorded data can be measured too by giving FORMAT:WIDTHxHEIGHT:FILE, where FILE contains raw blocks
+ * (e.g. `image data` of a Texture2D).
+ */
+#define _POSIX_C_SOURCE 200809L
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "astc.h"
+#include "bptc.h"
+#include "dxtc.h"
+#include "etc.h"
+#include "parallel.h"
+#include "png.h"
+#include "pvrtc.h"
+#include "rgb.h"
+
+_Thread_local const char *error_msg = NULL;
+
+typedef struct Format Format;
+typedef int (*BenchFunc)(const Format *, const uint8_t *, const long, const long, void *);
+
+struct Format {
+    const char *name;
+    int bw;
+    int bh;
+    int block_size;
+    BenchFunc func;
+    int (*block_decoder)(const uint8_t *, const long, const long, uint32_t *);
+};
+
+static int bench_blocks(const Format *f, const uint8_t *data, const long w, const long h, void *image) {
+    return f->block_decoder(data, w, h, image);
+}
+
+static int bench_astc(const Format *f, const uint8_t *data, const long w, const long h, void *image) {
+    return decode_astc(data, w, h, f->bw, f->bh, image);
+}
+
+static int bench_pvrtc(const Format *f, const uint8_t *data, const long w, const long h, void *image) {
+    return decode_pvrtc(data, w, h, image, f->bw == 8);
+}
+
+static int bench_rgb565(const Format *f, const uint8_t *data, const long w, const long h, void *image) {
+    return decode_rgb565((const uint16_t *)data, w * h, 0, image);
+}
+
+static int bench_rgbahalf(const Format *f, const uint8_t *data, const long w, const long h, void *image) {
+    return decode_rgbahalf((const uint16_t *)data, w * h, 0, image);
+}
+
+static int bench_rgbafloat(const Format *f, const uint8_t *data, const long w, const long h, void *image) {
+    return decode_rgbafloat(data, w, h, 0, image);
+}
+
+static int bench_rgb9e5float(const Format *f, const uint8_t *data, const long w, const long h, void *image) {
+    return decode_rgb9e5float(data, w, h, 0, image);
+}
+
+static int bench_argb4444(const Format *f, const uint8_t *data, const long w, const long h, void *image) {
+    return decode_argb4444(data, w, h, 0, image);
+}
+
+static int bench_bgra32(const Format *f, const uint8_t *data, const long w, const long h, void *image) {
+    return decode_bgra32(data, w, h, image);
+}
+
+// encodes the RGBA pixels given as data (so that the input is not random noise, decoded ETC2 pixels are used)
+static int bench_png(const Format *f, const uint8_t *data, const long w, const long h, void *image) {
+    uint8_t *png;
+    long png_len;
+    if (!encode_png(data, w, h, 4, PNG_LEVEL_DEFAULT, PNG_FILTER_ADAPTIVE, &png, &png_len))
+        return 0;
+    free(png);
+    return 1;
+}
+
+#define BLOCK_FORMAT(name, bw, bh, size, func) {name, bw, bh, size, bench_blocks, func}
+#define ASTC_FORMAT(name, bw, bh) {name, bw, bh, 16, bench_astc, NULL}
+
+static const Format Formats[] = {
+    BLOCK_FORMAT("etc1", 4, 4, 8, decode_etc1),
+    BLOCK_FORMAT("etc2", 4, 4, 8, decode_etc2),
+    BLOCK_FORMAT("etc2a1", 4, 4, 8, decode_etc2a1),
+    BLOCK_FORMAT("etc2a8", 4, 4, 16, decode_etc2a8),
+    BLOCK_FORMAT("eacr", 4, 4, 8, decode_eacr),
+    BLOCK_FORMAT("eacr_signed", 4, 4, 8, decode_eacr_signed),
+    BLOCK_FORMAT("eacrg", 4, 4, 16, decode_eacrg),
+    BLOCK_FORMAT("eacrg_signed", 4, 4, 16, decode_eacrg_signed),
+    BLOCK_FORMAT("dxt1", 4, 4, 8, decode_dxt1),
+    BLOCK_FORMAT("dxt5", 4, 4, 16, decode_dxt5),
+    BLOCK_FORMAT("bc4", 4, 4, 8, decode_bc4),
+    BLOCK_FORMAT("bc5", 4, 4, 16, decode_bc5),
+    BLOCK_FORMAT("bc6h", 4, 4, 16, decode_bc6h),
+    BLOCK_FORMAT("bc7", 4, 4, 16, decode_bc7),
+    {"pvrtc2", 8, 4, 8, bench_pvrtc, NULL},
+    {"pvrtc4", 4, 4, 8, bench_pvrtc, NULL},
+    ASTC_FORMAT("astc4x4", 4, 4),
+    ASTC_FORMAT("astc5x4", 5, 4),
+    ASTC_FORMAT("astc5x5", 5, 5),
+    ASTC_FORMAT("astc6x5", 6, 5),
+    ASTC_FORMAT("astc6x6", 6, 6),
+    ASTC_FORMAT("astc8x5", 8, 5),
+    ASTC_FORMAT("astc8x6", 8, 6),
+    ASTC_FORMAT("astc8x8", 8, 8),
+    ASTC_FORMAT("astc10x5", 10, 5),
+    ASTC_FORMAT("astc10x6", 10, 6),
+    ASTC_FORMAT("astc10x8", 10, 8),
+    ASTC_FORMAT("astc10x10", 10, 10),
+    ASTC_FORMAT("astc12x10", 12, 10),
+    ASTC_FORMAT("astc12x12", 12, 12),
+    {"rgb565", 1, 1, 2, bench_rgb565, NULL},
+    {"argb4444", 1, 1, 2, bench_argb4444, NULL},
+    {"bgra32", 1, 1, 4, bench_bgra32, NULL},
+    {"rgbahalf", 1, 1, 8, bench_rgbahalf, NULL},
+    {"rgbafloat", 1, 1, 16, bench_rgbafloat, NULL},
+    {"rgb9e5float", 1, 1, 4, bench_rgb9e5float, NULL},
+    {"png", 1, 1, 4, bench_png, NULL},
+};
+
+#define NUM_FORMATS ((int)(sizeof(Formats) / sizeof(Format)))
+
+static const Format *find_format(const char *name, const size_t len) {
+    for (int i = 0; i < NUM_FORMATS; i++)
+        if (strlen(Formats[i].name) == len && strncmp(Formats[i].name, name, len) == 0)
+            return Formats + i;
+    return NULL;
+}
+
+static double now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+// xorshift64*, so that the synthetic data are the same on every run
+static uint64_t random_state = 88172645463325252ULL;
+
+static uint64_t next_random(void) {
+    random_state ^= random_state >> 12;
+    random_state ^= random_state << 25;
+    random_state ^= random_state >> 27;
+    return random_state * 2685821657736338717ULL;
+}
+
+static void fill_random(uint8_t *buf, const long len) {
+    for (long i = 0; i < len; i++)
+        buf[i] = next_random() >> 56;
+}
+
+/*
+ * Fills legal ASTC blocks, which are picked from random blocks by decoding them
+ * Illegal blocks are decoded as the error color without any work, so they are not worth measuring.
+ */
+static int fill_astc(const Format *f, uint8_t *buf, const long num_blocks) {
+    enum { POOL_SIZE = 1024 };
+    static uint8_t pool[POOL_SIZE][16];
+    static const uint8_t error_color[4] = {255, 0, 255, 255};
+    uint32_t pixels[144], error_pixel;
+    memcpy(&error_pixel, error_color, 4);
+    int n = 0;
+    for (long tries = 0; n < POOL_SIZE && tries < POOL_SIZE * 1000L; tries++) {
+        fill_random(pool[n], 16);
+        // void-extent blocks are legal but trivial
+        if (pool[n][0] == 0xfc && (pool[n][1] & 1))
+            continue;
+        if (!decode_astc(pool[n], f->bw, f->bh, f->bw, f->bh, pixels)) {
+            error_msg = NULL;
+            continue;
+        }
+        int illegal = 1;
+        for (int i = 0; i < f->bw * f->bh && illegal; i++)
+            illegal = pixels[i] == error_pixel;
+        if (!illegal)
+            n++;
+    }
+    if (n == 0)
+        return 0;
+    for (long i = 0; i < num_blocks; i++)
+        memcpy(buf + i * 16, pool[next_random() % n], 16);
+    return 1;
+}
+
+/*
+ * Decodes data repeatedly for at least min_time seconds and prints the best throughput
+ */
+static void run(const Format *f, const char *label, const uint8_t *data, const long w, const long h,
+                const double min_time) {
+    uint32_t *image = malloc(w * h * 4);
+    if (!image) {
+        fprintf(stderr, "%s: failed to allocate memory\n", label);
+        return;
+    }
+    double best = 0, start = now();
+    int iterations = 0;
+    while (iterations < 3 || now() - start < min_time) {
+        double t = now();
+        if (!f->func(f, data, w, h, image)) {
+            printf("%-10s %-12s %5ldx%-5ld  error: %s\n", label, f->name, w, h, error_msg ? error_msg : "unknown");
+            error_msg = NULL;
+            free(image);
+            return;
+        }
+        t = now() - t;
+        if (best == 0 || t < best)
+            best = t;
+        iterations++;
+    }
+    printf("%-10s %-12s %5ldx%-5ld %10.2f Mpix/s\n", label, f->name, w, h, w * h / best * 1e-6);
+    free(image);
+}
+
+static long data_size(const Format *f, const long w, const long h) {
+    return ((w + f->bw - 1) / f->bw) * ((h + f->bh - 1) / f->bh) * f->block_size;
+}
+
+static void run_synthetic(const Format *f, const long w, const long h, const double min_time) {
+    long size = data_size(f, w, h);
+    uint8_t *data = malloc(size > w * h * 4 ? size : w * h * 4);
+    if (!data) {
+        fprintf(stderr, "%s: failed to allocate memory\n", f->name);
+        return;
+    }
+    if (f->func == bench_astc) {
+        if (!fill_astc(f, data, size / 16)) {
+            fprintf(stderr, "%s: no legal block found\n", f->name);
+            free(data);
+            return;
+        }
+    } else if (f->func == bench_png) {
+        const Format *etc2 = find_format("etc2", 4);
+        fill_random(data, data_size(etc2, w, h));
+        etc2->func(etc2, data, w, h, data);
+    } else {
+        fill_random(data, size);
+    }
+    run(f, "synthetic", data, w, h, min_time);
+    free(data);
+}
+
+// runs a recorded data given as FORMAT:WIDTHxHEIGHT:FILE
+static int run_recorded(const char *spec, const double min_time) {
+    const char *colon = strchr(spec, ':');
+    const Format *f = colon ? find_format(spec, colon - spec) : NULL;
+    char *end = NULL;
+    long w = f ? strtol(colon + 1, &end, 10) : 0;
+    long h = end && *end == 'x' ? strtol(end + 1, &end, 10) : 0;
+    if (w <= 0 || h <= 0 || *end != ':') {
+        fprintf(stderr, "invalid data spec: %s (FORMAT:WIDTHxHEIGHT:FILE)\n", spec);
+        return 0;
+    }
+    const char *path = end + 1;
+    FILE *fp = fopen(path, "rb");
+    if (!fp) {
+        perror(path);
+        return 0;
+    }
+    long size = data_size(f, w, h);
+    uint8_t *data = calloc(size > w * h * 4 ? size : w * h * 4, 1);
+    if (!data) {
+        fclose(fp);
+        fprintf(stderr, "%s: failed to allocate memory\n", path);
+        return 0;
+    }
+    long read = fread(data, 1, size, fp);
+    fclose(fp);
+    if (read < size) {
+        fprintf(stderr, "%s: %ld bytes are required but only %ld bytes are read\n", path, size, read);
+        free(data);
+        return 0;
+    }
+    const char *label = strrchr(path, '/') ? strrchr(path, '/') + 1 : path;
+    run(f, label, data, w, h, min_time);
+    free(data);
+    return 1;
+}
+
+static void usage(const char *prog) {
+    printf("usage: %s [-s SIZE] [-t THREADS] [-m SECONDS] [-f FORMAT[,FORMAT...]] [FORMAT:WIDTHxHEIGHT:FILE...]\n"
+           "  -s  width and height of synthetic images (default 1024)\n"
+           "  -t  number of decoder threads, 0 for all processors (default 1)\n"
+           "  -m  minimum time spent for each format (default 0.5)\n"
+           "  -f  formats measured on synthetic data (default all)\n"
+           "  -l  list formats\n"
+           "Recorded data are raw blocks of a texture, e.g. `image data` of a Texture2D.\n",
+           prog);
+}
+
+int main(int argc, char **argv) {
+    long size = 1024;
+    double min_time = 0.5;
+    const char *filter = NULL;
+    int i = 1;
+    for (; i < argc && argv[i][0] == '-'; i++) {
+        char opt = argv[i][1];
+        if (opt == 'h' || opt == 'l') {
+            if (opt == 'h')
+                usage(argv[0]);
+            else
+                for (int j = 0; j < NUM_FORMATS; j++)
+                    printf("%s\n", Formats[j].name);
+            return 0;
+        }
+        if (i + 1 >= argc || !strchr("stmf", opt)) {
+            usage(argv[0]);
+            return 1;
+        }
+        const char *arg = argv[++i];
+        if (opt == 's')
+            size = atol(arg);
+        else if (opt == 't')
+            set_decoder_threads(atoi(arg));
+        else if (opt == 'm')
+            min_time = atof(arg);
+        else
+            filter = arg;
+    }
+    if (size <= 0) {
+        usage(argv[0]);
+        return 1;
+    }
+
+    printf("decoder threads: %d\n", get_decoder_threads());
+    if (i < argc) {
+        int ok = 1;
+        for (; i < argc; i++)
+            ok &= run_recorded(argv[i], min_time);
+        return ok ? 0 : 1;
+    }
+    for (int j = 0; j < NUM_FORMATS; j++) {
+        if (filter) {
+            const char *p = filter;
+            size_t len = strlen(Formats[j].name);
+            int found = 0;
+            while (!found && *p) {
+                size_t n = strcspn(p, ",");
+                found = n == len && strncmp(p, Formats[j].name, n) == 0;
+                p += n + (p[n] == ',');
+            }
+            if (!found)
+                continue;
+        }
+        run_synthetic(Formats + j, size, size, min_time);
+    }
+    return 0;
+}
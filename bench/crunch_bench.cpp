@@ -0,0 +1,79 @@
+/*
+ * Standalone benchmark of the crunch decoder
+ * Build and run it by `rake bench`. Give .crn files (e.g. `image data` of a crunched Texture2D) as arguments.
+ *
+ * No synthetic data are used because there is no crunch encoder in this repository.
+ */
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+#include "crn_decomp.h"
+
+static bool read_file(const char *path, std::vector<uint8_t> &data) {
+    FILE *fp = std::fopen(path, "rb");
+    if (!fp) {
+        std::perror(path);
+        return false;
+    }
+    std::fseek(fp, 0, SEEK_END);
+    long size = std::ftell(fp);
+    std::fseek(fp, 0, SEEK_SET);
+    data.resize(size > 0 ? size : 0);
+    bool ok = size > 0 && std::fread(data.data(), 1, size, fp) == (size_t)size;
+    std::fclose(fp);
+    if (!ok)
+        std::fprintf(stderr, "%s: failed to read\n", path);
+    return ok;
+}
+
+// unpacks level 0 of the file repeatedly and prints the best throughput
+static bool run(const char *path, const double min_time) {
+    std::vector<uint8_t> data;
+    if (!read_file(path, data))
+        return false;
+    crnd::crn_level_info info;
+    if (!crnd::crnd_get_level_info(data.data(), data.size(), 0, &info)) {
+        std::fprintf(stderr, "%s: invalid crunch file\n", path);
+        return false;
+    }
+    const uint32_t pitch = info.m_blocks_x * info.m_bytes_per_block, size = pitch * info.m_blocks_y;
+    std::vector<uint8_t> out(size);
+    double best = 1e30, total = 0;
+    for (int iter = 0; iter < 3 || total < min_time; iter++) {
+        auto start = std::chrono::steady_clock::now();
+        void *out_ptr = out.data();
+        crnd::crnd_unpack_context context = crnd::crnd_unpack_begin(data.data(), data.size());
+        bool ok = context && crnd::crnd_unpack_level(context, &out_ptr, size, pitch, 0);
+        crnd::crnd_unpack_end(context);
+        if (!ok) {
+            std::fprintf(stderr, "%s: unpack error\n", path);
+            return false;
+        }
+        double t = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        best = t < best ? t : best;
+        total += t;
+    }
+    const char *label = std::strrchr(path, '/') ? std::strrchr(path, '/') + 1 : path;
+    std::printf("%-10s %-12s %5ux%-5u %10.2f Mpix/s\n", label, "crunch", info.m_width, info.m_height,
+                info.m_width * info.m_height / best * 1e-6);
+    return true;
+}
+
+int main(int argc, char **argv) {
+    double min_time = 0.5;
+    int i = 1;
+    if (i + 1 < argc && std::strcmp(argv[i], "-m") == 0) {
+        min_time = std::atof(argv[i + 1]);
+        i += 2;
+    }
+    if (i >= argc) {
+        std::printf("crunch: skipped (give .crn files, e.g. `rake bench CRN=a.crn,b.crn`)\n");
+        return 0;
+    }
+    bool ok = true;
+    for (; i < argc; i++)
+        ok &= run(argv[i], min_time);
+    return ok ? 0 : 1;
+}
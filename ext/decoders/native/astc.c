@@ -1,11 +1,11 @@
 #include "astc.h"
 #include <math.h>
-#include <ruby.h>
 #include <stdint.h>
 #include <stdlib.h>
 #include <string.h>
 #include "color.h"
 #include "fp16.h"
+#include "parallel.h"
 
 static const int BitReverseTable[] = {
   0x00, 0x80, 0x40, 0xC0, 0x20, 0xA0, 0x60, 0xE0, 0x10, 0x90, 0x50, 0xD0, 0x30, 0xB0, 0x70, 0xF0, 0x08, 0x88, 0x48,
@@ -320,7 +320,7 @@ void decode_intseq(const uint8_t *buf, int offset, const int a, const int b, con
     }
 }
 
-void decode_block_params(const uint8_t *buf, BlockData *block_data) {
+int decode_block_params(const uint8_t *buf, BlockData *block_data) {
     block_data->dual_plane = !!(buf[1] & 4);
     block_data->weight_range = (buf[0] >> 4 & 1) | (buf[1] << 2 & 8);
 
@@ -396,6 +396,11 @@ void decode_block_params(const uint8_t *buf, BlockData *block_data) {
         weight_bits = block_data->weight_num * WeightPrecTableB[block_data->weight_range];
     }
 
+    // illegal encodings, which are decoded as the error color
+    if (block_data->width > block_data->bw || block_data->height > block_data->bh || block_data->weight_num > 64 ||
+        weight_bits < 24 || weight_bits > 96 || (block_data->part_num == 4 && block_data->dual_plane))
+        return 0;
+
     if (block_data->part_num == 1) {
         block_data->cem[0] = u8ptr_to_u16(buf + 1) >> 5 & 0xf;
         config_bits = 17;
@@ -440,6 +445,10 @@ void decode_block_params(const uint8_t *buf, BlockData *block_data) {
     block_data->endpoint_value_num = 0;
     for (int i = 0; i < block_data->part_num; i++)
         block_data->endpoint_value_num += (block_data->cem[i] >> 1 & 6) + 2;
+    if (block_data->endpoint_value_num > 18)
+        return 0;
+
+    block_data->cem_range = -1;
 
     for (int i = 0, endpoint_bits; i < (int)(sizeof(CemTableA) / sizeof(int)); i++) {
         switch (CemTableA[i]) {
@@ -460,6 +469,7 @@ void decode_block_params(const uint8_t *buf, BlockData *block_data) {
             break;
         }
     }
+    return block_data->cem_range >= 0;
 }
 
 void decode_endpoints_hdr7(int *endpoints, int *v) {
@@ -671,7 +681,7 @@ void decode_endpoints_hdr11(int *endpoints, int *v, int alpha1, int alpha2) {
                                va - vb1, alpha2);
 }
 
-void decode_endpoints(const uint8_t *buf, BlockData *data) {
+int decode_endpoints(const uint8_t *buf, BlockData *data) {
     static const int TritsTable[] = {0, 204, 93, 44, 22, 11, 5};
     static const int QuintsTable[] = {0, 113, 54, 26, 13, 6};
     IntSeqData seq[32];
@@ -877,10 +887,14 @@ void decode_endpoints(const uint8_t *buf, BlockData *data) {
                 decode_endpoints_hdr11(data->endpoints[cem], v, v[6], clamp_hdr(v[6] + v[7]));
             }
         } break;
-        default:
-            rb_raise(rb_eStandardError, "Unsupported ASTC format");
+        default: {
+            extern _Thread_local const char *error_msg;
+            error_msg = "Unsupported ASTC format";
+            return 0;
+        }
         }
     }
+    return 1;
 }
 
 void decode_weights(const uint8_t *buf, BlockData *data) {
@@ -1110,7 +1124,7 @@ void applicate_color(const BlockData *data, uint32_t *outbuf) {
     }
 }
 
-void decode_block(const uint8_t *buf, const int bw, const int bh, uint32_t *outbuf) {
+int decode_block(const uint8_t *buf, const int bw, const int bh, uint32_t *outbuf) {
     if (buf[0] == 0xfc && (buf[1] & 1) == 1) {
         // void-extent
         uint_fast32_t c;
@@ -1120,34 +1134,59 @@ void decode_block(const uint8_t *buf, const int bw, const int bh, uint32_t *outb
             c = color(buf[9], buf[11], buf[13], buf[15]);
         for (int i = 0; i < bw * bh; i++)
             outbuf[i] = c;
-    } else if (((buf[0] & 0xc3) == 0xc0 && (buf[1] & 1) == 1) || (buf[0] & 0xf) == 0) {
-        // reserved (illegal)
+        return 1;
+    }
+
+    BlockData block_data;
+    block_data.bw = bw;
+    block_data.bh = bh;
+    if (((buf[0] & 0xc3) == 0xc0 && (buf[1] & 1) == 1) || (buf[0] & 0xf) == 0 ||
+        !decode_block_params(buf, &block_data)) {
+        // reserved or illegal
         uint_fast32_t c = color(255, 0, 255, 255);
         for (int i = 0; i < bw * bh; i++)
             outbuf[i] = c;
-    } else {
-        BlockData block_data;
-        block_data.bw = bw;
-        block_data.bh = bh;
-        decode_block_params(buf, &block_data);
-        decode_endpoints(buf, &block_data);
-        decode_weights(buf, &block_data);
-        if (block_data.part_num > 1)
-            select_partition(buf, &block_data);
-        applicate_color(&block_data, outbuf);
+        return 1;
     }
+
+    if (!decode_endpoints(buf, &block_data))
+        return 0;
+    decode_weights(buf, &block_data);
+    if (block_data.part_num > 1)
+        select_partition(buf, &block_data);
+    applicate_color(&block_data, outbuf);
+    return 1;
 }
 
-int decode_astc(const uint8_t *data, const long w, const long h, const int bw, const int bh, uint32_t *image) {
-    const long num_blocks_x = (w + bw - 1) / bw;
-    const long num_blocks_y = (h + bh - 1) / bh;
+typedef struct {
+    const uint8_t *data;
+    long w;
+    long h;
+    int bw;
+    int bh;
+    long num_blocks_x;
+    uint32_t *image;
+} AstcDecodeJob;
+
+static int decode_astc_rows(void *arg, const long by_begin, const long by_end) {
+    const AstcDecodeJob *job = (const AstcDecodeJob *)arg;
     uint32_t buffer[144];
-    const uint8_t *d = data;
-    for (long by = 0; by < num_blocks_y; by++) {
-        for (long bx = 0; bx < num_blocks_x; bx++, d += 16) {
-            decode_block(d, bw, bh, buffer);
-            copy_block_buffer(bx, by, w, h, bw, bh, buffer, image);
+    const uint8_t *d = job->data + by_begin * job->num_blocks_x * 16;
+    for (long by = by_begin; by < by_end; by++) {
+        for (long bx = 0; bx < job->num_blocks_x; bx++, d += 16) {
+            if (!decode_block(d, job->bw, job->bh, buffer))
+                return 0;
+            copy_block_buffer(bx, by, job->w, job->h, job->bw, job->bh, buffer, job->image);
         }
     }
     return 1;
 }
+
+int decode_astc(const uint8_t *data, const long w, const long h, const int bw, const int bh, uint32_t *image) {
+    const long num_blocks_x = (w + bw - 1) / bw;
+    const long num_blocks_y = (h + bh - 1) / bh;
+    AstcDecodeJob job = {data, w, h, bw, bh, num_blocks_x, image};
+    // ASTC blocks are expensive, so a thread takes at least 256 blocks instead of the default
+    long grain = num_blocks_x > 0 ? (256 + num_blocks_x - 1) / num_blocks_x : 1;
+    return parallel_for(num_blocks_y, grain, decode_astc_rows, &job);
+}
@@ -0,0 +1,498 @@
+#include "binary_reader.h"
+
+// strings shorter than this are copied instead of referring to the source
+#define MIN_VIEW_SIZE 4096
+
+static ID id_source;
+
+/*
+ * Returns len bytes at offset in str (which must be in range) without copying them
+ * The string is frozen and refers to the buffer of str, which is kept alive by it.
+ * (It must be frozen; otherwise Ruby would share the buffer as a static string without the reference.)
+ * Small strings, or parts of strings which are not frozen or embedded, are copied.
+ */
+VALUE str_view(VALUE str, long offset, long len) {
+    if (len < MIN_VIEW_SIZE || !OBJ_FROZEN(str) || !RB_FL_TEST_RAW(str, RSTRING_NOEMBED))
+        return rb_str_new(RSTRING_PTR(str) + offset, len);
+    VALUE ret = rb_str_new_static(RSTRING_PTR(str) + offset, len);
+    rb_ivar_set(ret, id_source, str);
+    return rb_obj_freeze(ret);
+}
+
+enum { READ_I16S, READ_I16U, READ_I32S, READ_I32U, READ_I64S, READ_I64U, READ_FLOAT, READ_DOUBLE };
+
+static ID id_little, id_read;
+
+static void binary_reader_mark(void *ptr) {
+    BinaryReader *r = (BinaryReader *)ptr;
+    rb_gc_mark(r->str);
+    rb_gc_mark(r->endian);
+}
+
+static size_t binary_reader_size(const void *ptr) {
+    return sizeof(BinaryReader);
+}
+
+static const rb_data_type_t binary_reader_type = {
+    "Mikunyan::BinaryReader",
+    {binary_reader_mark, RUBY_TYPED_DEFAULT_FREE, binary_reader_size},
+    NULL,
+    NULL,
+    RUBY_TYPED_FREE_IMMEDIATELY,
+};
+
+static VALUE rb_binary_reader_alloc(VALUE klass) {
+    BinaryReader *r;
+    VALUE self = TypedData_Make_Struct(klass, BinaryReader, &binary_reader_type, r);
+    r->str = rb_str_new_static("", 0);
+    r->endian = Qnil;
+    return self;
+}
+
+BinaryReader *get_binary_reader(VALUE self) {
+    BinaryReader *r;
+    TypedData_Get_Struct(self, BinaryReader, &binary_reader_type, r);
+    return r;
+}
+
+int is_little_endian(VALUE rb_endian) {
+    return SYMBOL_P(rb_endian) && SYM2ID(rb_endian) == id_little;
+}
+
+static void set_reader_endian(BinaryReader *r, VALUE rb_endian) {
+    r->endian = rb_endian;
+    r->little = is_little_endian(rb_endian);
+}
+
+static inline VALUE reader_value(BinaryReader *r, int type) {
+    uint32_t u32;
+    uint64_t u64;
+    float f;
+    double d;
+    switch (type) {
+    case READ_I16S:
+        return INT2FIX((int16_t)reader_u16(r));
+    case READ_I16U:
+        return INT2FIX(reader_u16(r));
+    case READ_I32S:
+        return INT2NUM((int32_t)reader_u32(r));
+    case READ_I32U:
+        return UINT2NUM(reader_u32(r));
+    case READ_I64S:
+        return LL2NUM((int64_t)reader_u64(r));
+    case READ_I64U:
+        return ULL2NUM(reader_u64(r));
+    case READ_FLOAT:
+        u32 = reader_u32(r);
+        memcpy(&f, &u32, 4);
+        return DBL2NUM(f);
+    default:
+        u64 = reader_u64(r);
+        memcpy(&d, &u64, 8);
+        return DBL2NUM(d);
+    }
+}
+
+/*
+ * Create a reader of binary data
+ * A string is read without copying (a frozen copy is made only if it is mutable), and an IO is read to the end.
+ *
+ * @param [String,IO] rb_io binary data
+ * @param [Symbol] rb_endian endianness (:big if omitted)
+ */
+static VALUE rb_binary_reader_initialize(int argc, VALUE *argv, VALUE self) {
+    rb_check_arity(argc, 1, 2);
+    BinaryReader *r = get_binary_reader(self);
+    VALUE str = argv[0];
+    if (!RB_TYPE_P(str, T_STRING)) {
+        str = rb_check_string_type(str);
+        if (NIL_P(str)) {
+            str = rb_funcall(argv[0], id_read, 0);
+            str = NIL_P(str) ? rb_str_new(NULL, 0) : str;
+        }
+    }
+    StringValue(str);
+    RB_OBJ_WRITE(self, &r->str, rb_str_new_frozen(str));
+    set_reader_endian(r, argc > 1 ? argv[1] : ID2SYM(rb_intern("big")));
+    r->pos = 0;
+    return self;
+}
+
+/*
+ * Get the endianness
+ *
+ * @return [Symbol] endianness
+ */
+static VALUE rb_binary_reader_endian(VALUE self) {
+    return get_binary_reader(self)->endian;
+}
+
+/*
+ * Set the endianness (:little, or :big for anything else)
+ *
+ * @param [Symbol] rb_endian endianness
+ * @return [Symbol] endianness
+ */
+static VALUE rb_binary_reader_set_endian(VALUE self, VALUE rb_endian) {
+    set_reader_endian(get_binary_reader(self), rb_endian);
+    return rb_endian;
+}
+
+/*
+ * Returns whether little endian or not
+ *
+ * @return [Boolean]
+ */
+static VALUE rb_binary_reader_little(VALUE self) {
+    return get_binary_reader(self)->little ? Qtrue : Qfalse;
+}
+
+/*
+ * Tells current position
+ *
+ * @return [Integer]
+ */
+static VALUE rb_binary_reader_pos(VALUE self) {
+    return LONG2NUM(get_binary_reader(self)->pos);
+}
+
+/*
+ * Jumps to given position (which can be beyond the end)
+ *
+ * @param [Integer] rb_pos position (0 if omitted)
+ * @return [Integer] position
+ */
+static VALUE rb_binary_reader_jmp(int argc, VALUE *argv, VALUE self) {
+    rb_check_arity(argc, 0, 1);
+    long pos = argc > 0 ? NUM2LONG(argv[0]) : 0;
+    if (pos < 0)
+        rb_raise(rb_eArgError, "Negative position.");
+    get_binary_reader(self)->pos = pos;
+    return LONG2NUM(pos);
+}
+
+/*
+ * Advances position given size
+ *
+ * @param [Integer] rb_size size (0 if omitted)
+ * @return [Integer] position
+ */
+static VALUE rb_binary_reader_adv(int argc, VALUE *argv, VALUE self) {
+    rb_check_arity(argc, 0, 1);
+    BinaryReader *r = get_binary_reader(self);
+    long pos = r->pos + (argc > 0 ? NUM2LONG(argv[0]) : 0);
+    if (pos < 0)
+        rb_raise(rb_eArgError, "Negative position.");
+    r->pos = pos;
+    return LONG2NUM(pos);
+}
+
+/*
+ * Rounds up position to multiple of given size
+ *
+ * @param [Integer] rb_size size
+ * @return [Integer] position
+ */
+static VALUE rb_binary_reader_align(VALUE self, VALUE rb_size) {
+    BinaryReader *r = get_binary_reader(self);
+    long size = NUM2LONG(rb_size);
+    if (size <= 0)
+        rb_raise(rb_eArgError, "Alignment must be positive.");
+    long rem = r->pos % size;
+    if (rem > 0)
+        r->pos += size - rem;
+    return LONG2NUM(r->pos);
+}
+
+/*
+ * Reads given size of binary string and seek
+ * A large string refers to the data without copying, and it is frozen.
+ *
+ * @param [Integer,nil] rb_size size (up to the end if nil)
+ * @return [String] data
+ */
+static VALUE rb_binary_reader_read(VALUE self, VALUE rb_size) {
+    BinaryReader *r = get_binary_reader(self);
+    long len = RSTRING_LEN(r->str);
+    long size = NIL_P(rb_size) ? (r->pos < len ? len - r->pos : 0) : NUM2LONG(rb_size);
+    long pos = r->pos;
+    reader_advance(r, size);
+    return str_view(r->str, pos, size);
+}
+
+/*
+ * Reads given size of binary string from specified position. This method does not seek.
+ * A large string refers to the data without copying as well as read.
+ *
+ * @param [Integer] rb_size size
+ * @param [Integer] rb_pos position
+ * @return [String] data
+ */
+static VALUE rb_binary_reader_read_abs(VALUE self, VALUE rb_size, VALUE rb_pos) {
+    BinaryReader *r = get_binary_reader(self);
+    long orig_pos = r->pos;
+    rb_binary_reader_jmp(1, &rb_pos, self);
+    long size = NUM2LONG(rb_size), pos = r->pos;
+    reader_advance(r, size);
+    r->pos = orig_pos;
+    return str_view(r->str, pos, size);
+}
+
+/*
+ * Reads string until null character
+ *
+ * @return [String] string
+ */
+static VALUE rb_binary_reader_cstr(VALUE self) {
+    BinaryReader *r = get_binary_reader(self);
+    long rest = RSTRING_LEN(r->str) - r->pos;
+    if (rest <= 0)
+        rb_raise(rb_eEOFError, "End of data reached.");
+    const char *ptr = RSTRING_PTR(r->str) + r->pos;
+    const char *end = memchr(ptr, 0, rest);
+    long size = end ? end - ptr : rest;
+    r->pos += end ? size + 1 : size;
+    return rb_str_new(ptr, size);
+}
+
+/*
+ * Reads an 8bit bool value
+ *
+ * @return [Boolean]
+ */
+static VALUE rb_binary_reader_bool(VALUE self) {
+    return *reader_advance(get_binary_reader(self), 1) ? Qtrue : Qfalse;
+}
+
+/*
+ * Reads an 8bit signed integer value
+ *
+ * @return [Integer]
+ */
+static VALUE rb_binary_reader_i8s(VALUE self) {
+    return INT2FIX((int8_t)*reader_advance(get_binary_reader(self), 1));
+}
+
+/*
+ * Reads an 8bit unsigned integer value
+ *
+ * @return [Integer]
+ */
+static VALUE rb_binary_reader_i8u(VALUE self) {
+    return INT2FIX(*reader_advance(get_binary_reader(self), 1));
+}
+
+/*
+ * Reads a 16bit signed integer value
+ *
+ * @return [Integer]
+ */
+static VALUE rb_binary_reader_i16s(VALUE self) {
+    return reader_value(get_binary_reader(self), READ_I16S);
+}
+
+/*
+ * Reads a 16bit unsigned integer value
+ *
+ * @return [Integer]
+ */
+static VALUE rb_binary_reader_i16u(VALUE self) {
+    return reader_value(get_binary_reader(self), READ_I16U);
+}
+
+/*
+ * Reads a 32bit signed integer value
+ *
+ * @return [Integer]
+ */
+static VALUE rb_binary_reader_i32s(VALUE self) {
+    return reader_value(get_binary_reader(self), READ_I32S);
+}
+
+/*
+ * Reads a 32bit unsigned integer value
+ *
+ * @return [Integer]
+ */
+static VALUE rb_binary_reader_i32u(VALUE self) {
+    return reader_value(get_binary_reader(self), READ_I32U);
+}
+
+/*
+ * Reads a 64bit signed integer value
+ *
+ * @return [Integer]
+ */
+static VALUE rb_binary_reader_i64s(VALUE self) {
+    return reader_value(get_binary_reader(self), READ_I64S);
+}
+
+/*
+ * Reads a 64bit unsigned integer value
+ *
+ * @return [Integer]
+ */
+static VALUE rb_binary_reader_i64u(VALUE self) {
+    return reader_value(get_binary_reader(self), READ_I64U);
+}
+
+/*
+ * Reads a 32bit floating point value
+ *
+ * @return [Float]
+ */
+static VALUE rb_binary_reader_float(VALUE self) {
+    return reader_value(get_binary_reader(self), READ_FLOAT);
+}
+
+/*
+ * Reads a 64bit floating point value
+ *
+ * @return [Float]
+ */
+static VALUE rb_binary_reader_double(VALUE self) {
+    return reader_value(get_binary_reader(self), READ_DOUBLE);
+}
+
+/*
+ * Reads rb_count values of the type into an Array
+ * The whole range is checked first, so nothing is read if it exceeds the end.
+ */
+static VALUE read_values(VALUE self, VALUE rb_count, int type, long unit) {
+    BinaryReader *r = get_binary_reader(self);
+    long count = NUM2LONG(rb_count);
+    if (count < 0)
+        rb_raise(rb_eArgError, "Negative count.");
+    if (count > (LONG_MAX - r->pos) / unit)
+        rb_raise(rb_eEOFError, "End of data reached.");
+    long start = r->pos;
+    reader_advance(r, count * unit);
+    r->pos = start;
+    VALUE ret = rb_ary_new_capa(count);
+    for (long i = 0; i < count; i++)
+        rb_ary_push(ret, reader_value(r, type));
+    return ret;
+}
+
+/*
+ * Reads 16bit signed integer values
+ *
+ * @param [Integer] rb_count number of values
+ * @return [Array<Integer>]
+ */
+static VALUE rb_binary_reader_i16s_array(VALUE self, VALUE rb_count) {
+    return read_values(self, rb_count, READ_I16S, 2);
+}
+
+/*
+ * Reads 16bit unsigned integer values
+ *
+ * @param [Integer] rb_count number of values
+ * @return [Array<Integer>]
+ */
+static VALUE rb_binary_reader_i16u_array(VALUE self, VALUE rb_count) {
+    return read_values(self, rb_count, READ_I16U, 2);
+}
+
+/*
+ * Reads 32bit signed integer values
+ *
+ * @param [Integer] rb_count number of values
+ * @return [Array<Integer>]
+ */
+static VALUE rb_binary_reader_i32s_array(VALUE self, VALUE rb_count) {
+    return read_values(self, rb_count, READ_I32S, 4);
+}
+
+/*
+ * Reads 32bit unsigned integer values
+ *
+ * @param [Integer] rb_count number of values
+ * @return [Array<Integer>]
+ */
+static VALUE rb_binary_reader_i32u_array(VALUE self, VALUE rb_count) {
+    return read_values(self, rb_count, READ_I32U, 4);
+}
+
+/*
+ * Reads 64bit signed integer values
+ *
+ * @param [Integer] rb_count number of values
+ * @return [Array<Integer>]
+ */
+static VALUE rb_binary_reader_i64s_array(VALUE self, VALUE rb_count) {
+    return read_values(self, rb_count, READ_I64S, 8);
+}
+
+/*
+ * Reads 64bit unsigned integer values
+ *
+ * @param [Integer] rb_count number of values
+ * @return [Array<Integer>]
+ */
+static VALUE rb_binary_reader_i64u_array(VALUE self, VALUE rb_count) {
+    return read_values(self, rb_count, READ_I64U, 8);
+}
+
+/*
+ * Reads 32bit floating point values
+ *
+ * @param [Integer] rb_count number of values
+ * @return [Array<Float>]
+ */
+static VALUE rb_binary_reader_float_array(VALUE self, VALUE rb_count) {
+    return read_values(self, rb_count, READ_FLOAT, 4);
+}
+
+/*
+ * Reads 64bit floating point values
+ *
+ * @param [Integer] rb_count number of values
+ * @return [Array<Float>]
+ */
+static VALUE rb_binary_reader_double_array(VALUE self, VALUE rb_count) {
+    return read_values(self, rb_count, READ_DOUBLE, 8);
+}
+
+void Init_binary_reader(VALUE mMikunyan) {
+    id_source = rb_intern("source");
+    id_little = rb_intern("little");
+    id_read = rb_intern("read");
+    VALUE cBinaryReader = rb_define_class_under(mMikunyan, "BinaryReader", rb_cObject);
+    rb_define_alloc_func(cBinaryReader, rb_binary_reader_alloc);
+    rb_define_method(cBinaryReader, "initialize", rb_binary_reader_initialize, -1);
+    rb_define_method(cBinaryReader, "endian", rb_binary_reader_endian, 0);
+    rb_define_method(cBinaryReader, "endian=", rb_binary_reader_set_endian, 1);
+    rb_define_method(cBinaryReader, "little?", rb_binary_reader_little, 0);
+    rb_define_method(cBinaryReader, "pos", rb_binary_reader_pos, 0);
+    rb_define_method(cBinaryReader, "jmp", rb_binary_reader_jmp, -1);
+    rb_define_method(cBinaryReader, "pos=", rb_binary_reader_jmp, -1);
+    rb_define_method(cBinaryReader, "adv", rb_binary_reader_adv, -1);
+    rb_define_method(cBinaryReader, "align", rb_binary_reader_align, 1);
+    rb_define_method(cBinaryReader, "read", rb_binary_reader_read, 1);
+    rb_define_method(cBinaryReader, "read_abs", rb_binary_reader_read_abs, 2);
+    rb_define_method(cBinaryReader, "cstr", rb_binary_reader_cstr, 0);
+    rb_define_method(cBinaryReader, "bool", rb_binary_reader_bool, 0);
+    rb_define_method(cBinaryReader, "i8s", rb_binary_reader_i8s, 0);
+    rb_define_method(cBinaryReader, "i8u", rb_binary_reader_i8u, 0);
+    rb_define_method(cBinaryReader, "i16s", rb_binary_reader_i16s, 0);
+    rb_define_method(cBinaryReader, "i16u", rb_binary_reader_i16u, 0);
+    rb_define_method(cBinaryReader, "i32s", rb_binary_reader_i32s, 0);
+    rb_define_method(cBinaryReader, "i32u", rb_binary_reader_i32u, 0);
+    rb_define_method(cBinaryReader, "i64s", rb_binary_reader_i64s, 0);
+    rb_define_method(cBinaryReader, "i64u", rb_binary_reader_i64u, 0);
+    rb_define_method(cBinaryReader, "float", rb_binary_reader_float, 0);
+    rb_define_method(cBinaryReader, "double", rb_binary_reader_double, 0);
+    rb_define_method(cBinaryReader, "i16s_array", rb_binary_reader_i16s_array, 1);
+    rb_define_method(cBinaryReader, "i16u_array", rb_binary_reader_i16u_array, 1);
+    rb_define_method(cBinaryReader, "i32s_array", rb_binary_reader_i32s_array, 1);
+    rb_define_method(cBinaryReader, "i32u_array", rb_binary_reader_i32u_array, 1);
+    rb_define_method(cBinaryReader, "i64s_array", rb_binary_reader_i64s_array, 1);
+    rb_define_method(cBinaryReader, "i64u_array", rb_binary_reader_i64u_array, 1);
+    rb_define_method(cBinaryReader, "float_array", rb_binary_reader_float_array, 1);
+    rb_define_method(cBinaryReader, "double_array", rb_binary_reader_double_array, 1);
+    rb_define_alias(cBinaryReader, "i8", "i8s");
+    rb_define_alias(cBinaryReader, "i16", "i16s");
+    rb_define_alias(cBinaryReader, "i32", "i32s");
+    rb_define_alias(cBinaryReader, "i64", "i64s");
+}
@@ -0,0 +1,50 @@
+#ifndef BINARY_READER_H
+#define BINARY_READER_H
+
+#include <ruby.h>
+#include <stdint.h>
+#include <string.h>
+#include "endianness.h"
+
+typedef struct {
+    VALUE str;
+    VALUE endian;
+    long pos;
+    int little;
+} BinaryReader;
+
+VALUE str_view(VALUE, long, long);
+BinaryReader *get_binary_reader(VALUE);
+int is_little_endian(VALUE);
+void Init_binary_reader(VALUE);
+
+/*
+ * Returns the pointer to size bytes at the current position and advances the position
+ */
+static inline const uint8_t *reader_advance(BinaryReader *r, long size) {
+    if (size < 0 || r->pos > RSTRING_LEN(r->str) - size)
+        rb_raise(rb_eEOFError, "End of data reached.");
+    const uint8_t *ptr = (const uint8_t *)RSTRING_PTR(r->str) + r->pos;
+    r->pos += size;
+    return ptr;
+}
+
+static inline uint16_t reader_u16(BinaryReader *r) {
+    uint16_t v;
+    memcpy(&v, reader_advance(r, 2), 2);
+    return r->little ? lton16(v) : bton16(v);
+}
+
+static inline uint32_t reader_u32(BinaryReader *r) {
+    uint32_t v;
+    memcpy(&v, reader_advance(r, 4), 4);
+    return r->little ? lton32(v) : bton32(v);
+}
+
+static inline uint64_t reader_u64(BinaryReader *r) {
+    uint64_t v;
+    memcpy(&v, reader_advance(r, 8), 8);
+    return r->little ? lton64(v) : bton64(v);
+}
+
+#endif /* end of include guard: BINARY_READER_H */
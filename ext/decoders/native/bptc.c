@@ -0,0 +1,380 @@
+#include "bptc.h"
+#include <math.h>
+#include <stdint.h>
+#include <string.h>
+#include "color.h"
+#include "endianness.h"
+#include "fp16.h"
+#include "parallel.h"
+
+// subset of each pixel for 2-subset partitions (bit i is pixel i)
+static const uint_fast16_t Partition2Table[64] = {
+  0xcccc, 0x8888, 0xeeee, 0xecc8, 0xc880, 0xfeec, 0xfec8, 0xec80, 0xc800, 0xffec, 0xfe80, 0xe800, 0xffe8,
+  0xff00, 0xfff0, 0xf000, 0xf710, 0x008e, 0x7100, 0x08ce, 0x008c, 0x7310, 0x3100, 0x8cce, 0x088c, 0x3110,
+  0x6666, 0x366c, 0x17e8, 0x0ff0, 0x718e, 0x399c, 0xaaaa, 0xf0f0, 0x5a5a, 0x33cc, 0x3c3c, 0x55aa, 0x9696,
+  0xa55a, 0x73ce, 0x13c8, 0x324c, 0x3bdc, 0x6996, 0xc33c, 0x9966, 0x0660, 0x0272, 0x04e4, 0x4e40, 0x2720,
+  0xc936, 0x936c, 0x39c6, 0x639c, 0x9336, 0x9cc6, 0x817e, 0xe718, 0xccf0, 0x0fcc, 0x7744, 0xee22};
+
+static const uint_fast8_t Partition3Table[64][16] = {
+  {0, 0, 1, 1, 0, 0, 1, 1, 0, 2, 2, 1, 2, 2, 2, 2}, {0, 0, 0, 1, 0, 0, 1, 1, 2, 2, 1, 1, 2, 2, 2, 1},
+  {0, 0, 0, 0, 2, 0, 0, 1, 2, 2, 1, 1, 2, 2, 1, 1}, {0, 2, 2, 2, 0, 0, 2, 2, 0, 0, 1, 1, 0, 1, 1, 1},
+  {0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 2, 2, 1, 1, 2, 2}, {0, 0, 1, 1, 0, 0, 1, 1, 0, 0, 2, 2, 0, 0, 2, 2},
+  {0, 0, 2, 2, 0, 0, 2, 2, 1, 1, 1, 1, 1, 1, 1, 1}, {0, 0, 1, 1, 0, 0, 1, 1, 2, 2, 1, 1, 2, 2, 1, 1},
+  {0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2}, {0, 0, 0, 0, 1, 1, 1, 1, 1, 1, 1, 1, 2, 2, 2, 2},
+  {0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2, 2, 2, 2, 2}, {0, 0, 1, 2, 0, 0, 1, 2, 0, 0, 1, 2, 0, 0, 1, 2},
+  {0, 1, 1, 2, 0, 1, 1, 2, 0, 1, 1, 2, 0, 1, 1, 2}, {0, 1, 2, 2, 0, 1, 2, 2, 0, 1, 2, 2, 0, 1, 2, 2},
+  {0, 0, 1, 1, 0, 1, 1, 2, 1, 1, 2, 2, 1, 2, 2, 2}, {0, 0, 1, 1, 2, 0, 0, 1, 2, 2, 0, 0, 2, 2, 2, 0},
+  {0, 0, 0, 1, 0, 0, 1, 1, 0, 1, 1, 2, 1, 1, 2, 2}, {0, 1, 1, 1, 0, 0, 1, 1, 2, 0, 0, 1, 2, 2, 0, 0},
+  {0, 0, 0, 0, 1, 1, 2, 2, 1, 1, 2, 2, 1, 1, 2, 2}, {0, 0, 2, 2, 0, 0, 2, 2, 0, 0, 2, 2, 1, 1, 1, 1},
+  {0, 1, 1, 1, 0, 1, 1, 1, 0, 2, 2, 2, 0, 2, 2, 2}, {0, 0, 0, 1, 0, 0, 0, 1, 2, 2, 2, 1, 2, 2, 2, 1},
+  {0, 0, 0, 0, 0, 0, 1, 1, 0, 1, 2, 2, 0, 1, 2, 2}, {0, 0, 0, 0, 1, 1, 0, 0, 2, 2, 1, 0, 2, 2, 1, 0},
+  {0, 1, 2, 2, 0, 1, 2, 2, 0, 0, 1, 1, 0, 0, 0, 0}, {0, 0, 1, 2, 0, 0, 1, 2, 1, 1, 2, 2, 2, 2, 2, 2},
+  {0, 1, 1, 0, 1, 2, 2, 1, 1, 2, 2, 1, 0, 1, 1, 0}, {0, 0, 0, 0, 0, 1, 1, 0, 1, 2, 2, 1, 1, 2, 2, 1},
+  {0, 0, 2, 2, 1, 1, 0, 2, 1, 1, 0, 2, 0, 0, 2, 2}, {0, 1, 1, 0, 0, 1, 1, 0, 2, 0, 0, 2, 2, 2, 2, 2},
+  {0, 0, 1, 1, 0, 1, 2, 2, 0, 1, 2, 2, 0, 0, 1, 1}, {0, 0, 0, 0, 2, 0, 0, 0, 2, 2, 1, 1, 2, 2, 2, 1},
+  {0, 0, 0, 0, 0, 0, 0, 2, 1, 1, 2, 2, 1, 2, 2, 2}, {0, 2, 2, 2, 0, 0, 2, 2, 0, 0, 1, 2, 0, 0, 1, 1},
+  {0, 0, 1, 1, 0, 0, 1, 2, 0, 0, 2, 2, 0, 2, 2, 2}, {0, 1, 2, 0, 0, 1, 2, 0, 0, 1, 2, 0, 0, 1, 2, 0},
+  {0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2, 0, 0, 0, 0}, {0, 1, 2, 0, 1, 2, 0, 1, 2, 0, 1, 2, 0, 1, 2, 0},
+  {0, 1, 2, 0, 2, 0, 1, 2, 1, 2, 0, 1, 0, 1, 2, 0}, {0, 0, 1, 1, 2, 2, 0, 0, 1, 1, 2, 2, 0, 0, 1, 1},
+  {0, 0, 1, 1, 1, 1, 2, 2, 2, 2, 0, 0, 0, 0, 1, 1}, {0, 1, 0, 1, 0, 1, 0, 1, 2, 2, 2, 2, 2, 2, 2, 2},
+  {0, 0, 0, 0, 0, 0, 0, 0, 2, 1, 2, 1, 2, 1, 2, 1}, {0, 0, 2, 2, 1, 1, 2, 2, 0, 0, 2, 2, 1, 1, 2, 2},
+  {0, 0, 2, 2, 0, 0, 1, 1, 0, 0, 2, 2, 0, 0, 1, 1}, {0, 2, 2, 0, 1, 2, 2, 1, 0, 2, 2, 0, 1, 2, 2, 1},
+  {0, 1, 0, 1, 2, 2, 2, 2, 2, 2, 2, 2, 0, 1, 0, 1}, {0, 0, 0, 0, 2, 1, 2, 1, 2, 1, 2, 1, 2, 1, 2, 1},
+  {0, 1, 0, 1, 0, 1, 0, 1, 0, 1, 0, 1, 2, 2, 2, 2}, {0, 2, 2, 2, 0, 1, 1, 1, 0, 2, 2, 2, 0, 1, 1, 1},
+  {0, 0, 0, 2, 1, 1, 1, 2, 0, 0, 0, 2, 1, 1, 1, 2}, {0, 0, 0, 0, 2, 1, 1, 2, 2, 1, 1, 2, 2, 1, 1, 2},
+  {0, 2, 2, 2, 0, 1, 1, 1, 0, 1, 1, 1, 0, 2, 2, 2}, {0, 0, 0, 2, 1, 1, 1, 2, 1, 1, 1, 2, 0, 0, 0, 2},
+  {0, 1, 1, 0, 0, 1, 1, 0, 0, 1, 1, 0, 2, 2, 2, 2}, {0, 0, 0, 0, 0, 0, 0, 0, 2, 1, 1, 2, 2, 1, 1, 2},
+  {0, 1, 1, 0, 0, 1, 1, 0, 2, 2, 2, 2, 2, 2, 2, 2}, {0, 0, 2, 2, 0, 0, 1, 1, 0, 0, 1, 1, 0, 0, 2, 2},
+  {0, 0, 2, 2, 1, 1, 2, 2, 1, 1, 2, 2, 0, 0, 2, 2}, {0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 2, 1, 1, 2},
+  {0, 0, 0, 2, 0, 0, 0, 1, 0, 0, 0, 2, 0, 0, 0, 1}, {0, 2, 2, 2, 1, 2, 2, 2, 0, 2, 2, 2, 1, 2, 2, 2},
+  {0, 1, 0, 1, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2}, {0, 1, 1, 1, 2, 0, 1, 1, 2, 2, 0, 1, 2, 2, 2, 0}};
+
+// anchor pixel of the second subset of 2-subset partitions
+static const uint_fast8_t Anchor2Table[64] = {
+  15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15,
+  15,  2,  8,  2,  2,  8,  8, 15,  2,  8,  2,  2,  8,  8,  2,  2,
+  15, 15,  6,  8,  2,  8, 15, 15,  2,  8,  2,  2,  2, 15, 15,  6,
+   6,  2,  6,  8, 15, 15,  2,  2, 15, 15, 15, 15, 15,  2,  2, 15};
+
+// anchor pixels of the second and the third subsets of 3-subset partitions
+static const uint_fast8_t Anchor3Table[2][64] = {
+  { 3,  3, 15, 15,  8,  3, 15, 15,  8,  8,  6,  6,  6,  5,  3,  3,
+    3,  3,  8, 15,  3,  3,  6, 10,  5,  8,  8,  6,  8,  5, 15, 15,
+    8, 15,  3,  5,  6, 10,  8, 15, 15,  3, 15,  5, 15, 15, 15, 15,
+    3, 15,  5,  5,  5,  8,  5, 10,  5, 10,  8, 13, 15, 12,  3,  3},
+  {15,  8,  8,  3, 15, 15,  3,  8, 15, 15, 15, 15, 15, 15, 15,  8,
+   15,  8, 15,  3, 15,  8, 15,  8,  3, 15,  6, 10, 15, 15, 10,  8,
+   15,  3, 15, 10, 10,  8,  9, 10,  6, 15,  8, 15,  3,  6,  6,  8,
+   15,  3, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15,  3, 15, 15,  8}};
+
+static const uint_fast8_t Weight2Table[4] = {0, 21, 43, 64};
+static const uint_fast8_t Weight3Table[8] = {0, 9, 18, 27, 37, 46, 55, 64};
+static const uint_fast8_t Weight4Table[16] = {0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64};
+static const uint_fast8_t *const WeightTable[5] = {NULL, NULL, Weight2Table, Weight3Table, Weight4Table};
+
+// 128-bit block read from the least significant bit
+typedef struct {
+    uint_fast64_t low;
+    uint_fast64_t high;
+} BitStream;
+
+static inline BitStream bitstream_init(const uint8_t *data) {
+    return (BitStream){lton64(*(uint64_t *)data), lton64(*(uint64_t *)(data + 8))};
+}
+
+static inline uint_fast32_t bitstream_read(BitStream *bs, const int bits) {
+    if (bits == 0)
+        return 0;
+    uint_fast32_t ret = bs->low & ((1ull << bits) - 1);
+    bs->low = bs->low >> bits | bs->high << (64 - bits);
+    bs->high >>= bits;
+    return ret;
+}
+
+static inline int interpolate(const int e0, const int e1, const uint_fast8_t weight) {
+    return ((64 - weight) * e0 + weight * e1 + 32) >> 6;
+}
+
+static inline int is_anchor(const int subsets, const int partition, const int i) {
+    if (i == 0)
+        return 1;
+    else if (subsets == 2)
+        return i == Anchor2Table[partition];
+    else if (subsets == 3)
+        return i == Anchor3Table[0][partition] || i == Anchor3Table[1][partition];
+    else
+        return 0;
+}
+
+static inline int subset_of(const int subsets, const int partition, const int i) {
+    if (subsets == 2)
+        return Partition2Table[partition] >> i & 1;
+    else if (subsets == 3)
+        return Partition3Table[partition][i];
+    else
+        return 0;
+}
+
+/*
+ * BC6H
+ */
+
+// header fields: endpoints w, x, y, z of each channel and the partition number
+enum {
+    BC6H_RW, BC6H_GW, BC6H_BW,
+    BC6H_RX, BC6H_GX, BC6H_BX,
+    BC6H_RY, BC6H_GY, BC6H_BY,
+    BC6H_RZ, BC6H_GZ, BC6H_BZ,
+    BC6H_D
+};
+
+// bits of a header field: `count` bits from the stream go to `field` starting at bit `shift`
+typedef struct {
+    uint_fast8_t field;
+    uint_fast8_t shift;
+    uint_fast8_t count;
+} Bc6hSegment;
+
+typedef struct {
+    int regions;
+    int transformed;
+    int endpoint_bits;
+    int delta_bits[3];
+    Bc6hSegment segments[32];
+} Bc6hMode;
+
+#define S(f, shift, count) {BC6H_##f, shift, count}
+static const Bc6hMode Bc6hModes[14] = {
+  {2, 1, 10, {5, 5, 5}, {S(GY, 4, 1), S(BY, 4, 1), S(BZ, 4, 1), S(RW, 0, 10), S(GW, 0, 10), S(BW, 0, 10), S(RX, 0, 5),
+                         S(GZ, 4, 1), S(GY, 0, 4), S(GX, 0, 5), S(BZ, 0, 1), S(GZ, 0, 4), S(BX, 0, 5), S(BZ, 1, 1),
+                         S(BY, 0, 4), S(RY, 0, 5), S(BZ, 2, 1), S(RZ, 0, 5), S(BZ, 3, 1), S(D, 0, 5)}},
+  {2, 1, 7, {6, 6, 6}, {S(GY, 5, 1), S(GZ, 4, 1), S(GZ, 5, 1), S(RW, 0, 7), S(BZ, 0, 1), S(BZ, 1, 1), S(BY, 4, 1),
+                        S(GW, 0, 7), S(BY, 5, 1), S(BZ, 2, 1), S(GY, 4, 1), S(BW, 0, 7), S(BZ, 3, 1), S(BZ, 5, 1),
+                        S(BZ, 4, 1), S(RX, 0, 6), S(GY, 0, 4), S(GX, 0, 6), S(GZ, 0, 4), S(BX, 0, 6), S(BY, 0, 4),
+                        S(RY, 0, 6), S(RZ, 0, 6), S(D, 0, 5)}},
+  {2, 1, 11, {5, 4, 4}, {S(RW, 0, 10), S(GW, 0, 10), S(BW, 0, 10), S(RX, 0, 5), S(RW, 10, 1), S(GY, 0, 4), S(GX, 0, 4),
+                         S(GW, 10, 1), S(BZ, 0, 1), S(GZ, 0, 4), S(BX, 0, 4), S(BW, 10, 1), S(BZ, 1, 1), S(BY, 0, 4),
+                         S(RY, 0, 5), S(BZ, 2, 1), S(RZ, 0, 5), S(BZ, 3, 1), S(D, 0, 5)}},
+  {2, 1, 11, {4, 5, 4}, {S(RW, 0, 10), S(GW, 0, 10), S(BW, 0, 10), S(RX, 0, 4), S(RW, 10, 1), S(GZ, 4, 1), S(GY, 0, 4),
+                         S(GX, 0, 5), S(GW, 10, 1), S(GZ, 0, 4), S(BX, 0, 4), S(BW, 10, 1), S(BZ, 1, 1), S(BY, 0, 4),
+                         S(RY, 0, 4), S(BZ, 0, 1), S(BZ, 2, 1), S(RZ, 0, 4), S(GY, 4, 1), S(BZ, 3, 1), S(D, 0, 5)}},
+  {2, 1, 11, {4, 4, 5}, {S(RW, 0, 10), S(GW, 0, 10), S(BW, 0, 10), S(RX, 0, 4), S(RW, 10, 1), S(BY, 4, 1), S(GY, 0, 4),
+                         S(GX, 0, 4), S(GW, 10, 1), S(BZ, 0, 1), S(GZ, 0, 4), S(BX, 0, 5), S(BW, 10, 1), S(BY, 0, 4),
+                         S(RY, 0, 4), S(BZ, 1, 1), S(BZ, 2, 1), S(RZ, 0, 4), S(BZ, 4, 1), S(BZ, 3, 1), S(D, 0, 5)}},
+  {2, 1, 9, {5, 5, 5}, {S(RW, 0, 9), S(BY, 4, 1), S(GW, 0, 9), S(GY, 4, 1), S(BW, 0, 9), S(BZ, 4, 1), S(RX, 0, 5),
+                        S(GZ, 4, 1), S(GY, 0, 4), S(GX, 0, 5), S(BZ, 0, 1), S(GZ, 0, 4), S(BX, 0, 5), S(BZ, 1, 1),
+                        S(BY, 0, 4), S(RY, 0, 5), S(BZ, 2, 1), S(RZ, 0, 5), S(BZ, 3, 1), S(D, 0, 5)}},
+  {2, 1, 8, {6, 5, 5}, {S(RW, 0, 8), S(GZ, 4, 1), S(BY, 4, 1), S(GW, 0, 8), S(BZ, 2, 1), S(GY, 4, 1), S(BW, 0, 8),
+                        S(BZ, 3, 1), S(BZ, 4, 1), S(RX, 0, 6), S(GY, 0, 4), S(GX, 0, 5), S(BZ, 0, 1), S(GZ, 0, 4),
+                        S(BX, 0, 5), S(BZ, 1, 1), S(BY, 0, 4), S(RY, 0, 6), S(RZ, 0, 6), S(D, 0, 5)}},
+  {2, 1, 8, {5, 6, 5}, {S(RW, 0, 8), S(BZ, 0, 1), S(BY, 4, 1), S(GW, 0, 8), S(GY, 5, 1), S(GY, 4, 1), S(BW, 0, 8),
+                        S(GZ, 5, 1), S(BZ, 4, 1), S(RX, 0, 5), S(GZ, 4, 1), S(GY, 0, 4), S(GX, 0, 6), S(GZ, 0, 4),
+                        S(BX, 0, 5), S(BZ, 1, 1), S(BY, 0, 4), S(RY, 0, 5), S(BZ, 2, 1), S(RZ, 0, 5), S(BZ, 3, 1),
+                        S(D, 0, 5)}},
+  {2, 1, 8, {5, 5, 6}, {S(RW, 0, 8), S(BZ, 1, 1), S(BY, 4, 1), S(GW, 0, 8), S(BY, 5, 1), S(GY, 4, 1), S(BW, 0, 8),
+                        S(BZ, 5, 1), S(BZ, 4, 1), S(RX, 0, 5), S(GZ, 4, 1), S(GY, 0, 4), S(GX, 0, 5), S(BZ, 0, 1),
+                        S(GZ, 0, 4), S(BX, 0, 6), S(BY, 0, 4), S(RY, 0, 5), S(BZ, 2, 1), S(RZ, 0, 5), S(BZ, 3, 1),
+                        S(D, 0, 5)}},
+  {2, 0, 6, {6, 6, 6}, {S(RW, 0, 6), S(GZ, 4, 1), S(BZ, 0, 1), S(BZ, 1, 1), S(BY, 4, 1), S(GW, 0, 6), S(GY, 5, 1),
+                        S(BY, 5, 1), S(BZ, 2, 1), S(GY, 4, 1), S(BW, 0, 6), S(GZ, 5, 1), S(BZ, 3, 1), S(BZ, 5, 1),
+                        S(BZ, 4, 1), S(RX, 0, 6), S(GY, 0, 4), S(GX, 0, 6), S(GZ, 0, 4), S(BX, 0, 6), S(BY, 0, 4),
+                        S(RY, 0, 6), S(RZ, 0, 6), S(D, 0, 5)}},
+  {1, 0, 10, {10, 10, 10}, {S(RW, 0, 10), S(GW, 0, 10), S(BW, 0, 10), S(RX, 0, 10), S(GX, 0, 10), S(BX, 0, 10)}},
+  {1, 1, 11, {9, 9, 9}, {S(RW, 0, 10), S(GW, 0, 10), S(BW, 0, 10), S(RX, 0, 9), S(RW, 10, 1), S(GX, 0, 9),
+                         S(GW, 10, 1), S(BX, 0, 9), S(BW, 10, 1)}},
+  {1, 1, 12, {8, 8, 8}, {S(RW, 0, 10), S(GW, 0, 10), S(BW, 0, 10), S(RX, 0, 8), S(RW, 11, 1), S(RW, 10, 1), S(GX, 0, 8),
+                         S(GW, 11, 1), S(GW, 10, 1), S(BX, 0, 8), S(BW, 11, 1), S(BW, 10, 1)}},
+  {1, 1, 16, {4, 4, 4}, {S(RW, 0, 10), S(GW, 0, 10), S(BW, 0, 10), S(RX, 0, 4), S(RW, 15, 1), S(RW, 14, 1),
+                         S(RW, 13, 1), S(RW, 12, 1), S(RW, 11, 1), S(RW, 10, 1), S(GX, 0, 4), S(GW, 15, 1),
+                         S(GW, 14, 1), S(GW, 13, 1), S(GW, 12, 1), S(GW, 11, 1), S(GW, 10, 1), S(BX, 0, 4),
+                         S(BW, 15, 1), S(BW, 14, 1), S(BW, 13, 1), S(BW, 12, 1), S(BW, 11, 1), S(BW, 10, 1)}}};
+#undef S
+
+// mode number (low 5 bits of a block) -> index of Bc6hModes, -1 if reserved
+static const int_fast8_t Bc6hModeIndexTable[32] = {0,  1,  2, 10, -1, -1, 3, 11, -1, -1, 4, 12, -1, -1, 5, 13,
+                                                   -1, -1, 6, -1, -1, -1, 7, -1, -1, -1, 8, -1, -1, -1, 9, -1};
+
+static inline int sign_extend(const int value, const int bits) {
+    return (value ^ 1 << (bits - 1)) - (1 << (bits - 1));
+}
+
+static inline int bc6h_unquantize(const int value, const int bits) {
+    if (bits >= 15 || value == 0)
+        return value;
+    else if (value == (1 << bits) - 1)
+        return 0xffff;
+    else
+        return ((value << 16) + 0x8000) >> bits;
+}
+
+static inline uint8_t u16_f16_u8(const uint16_t val) {
+    float f = fp16_ieee_to_fp32_value(val);
+    if (!isfinite(f) || f < 0)
+        return 0;
+    else if (f > 1)
+        return 255;
+    else
+        return roundf(f * 255);
+}
+
+static void decode_bc6h_block(const uint8_t *data, uint32_t *outbuf) {
+    BitStream bs = bitstream_init(data);
+    int mode_bits = bitstream_read(&bs, 2);
+    if (mode_bits > 1)
+        mode_bits |= bitstream_read(&bs, 3) << 2;
+    const int mode_index = Bc6hModeIndexTable[mode_bits];
+    if (mode_index < 0) {
+        // reserved modes are decoded as black
+        for (int i = 0; i < 16; i++)
+            outbuf[i] = color(0, 0, 0, 255);
+        return;
+    }
+    const Bc6hMode *mode = Bc6hModes + mode_index;
+
+    int fields[13] = {0};
+    for (const Bc6hSegment *seg = mode->segments; seg->count; seg++)
+        fields[seg->field] |= bitstream_read(&bs, seg->count) << seg->shift;
+
+    // endpoints[region * 2 + end][channel]
+    int endpoints[4][3];
+    const int endpoint_mask = (1 << mode->endpoint_bits) - 1;
+    const int count = mode->regions * 2;
+    for (int c = 0; c < 3; c++) {
+        endpoints[0][c] = fields[BC6H_RW + c];
+        for (int e = 1; e < count; e++) {
+            int v = fields[BC6H_RW + e * 3 + c];
+            if (mode->transformed)
+                v = (endpoints[0][c] + sign_extend(v, mode->delta_bits[c])) & endpoint_mask;
+            endpoints[e][c] = bc6h_unquantize(v, mode->endpoint_bits);
+        }
+        endpoints[0][c] = bc6h_unquantize(endpoints[0][c], mode->endpoint_bits);
+    }
+
+    const int partition = fields[BC6H_D];
+    const int index_bits = mode->regions == 2 ? 3 : 4;
+    const uint_fast8_t *weights = WeightTable[index_bits];
+    for (int i = 0; i < 16; i++) {
+        const int index = bitstream_read(&bs, index_bits - is_anchor(mode->regions, partition, i));
+        const int *e = endpoints[subset_of(mode->regions, partition, i) * 2];
+        uint8_t rgb[3];
+        for (int c = 0; c < 3; c++)
+            rgb[c] = u16_f16_u8(interpolate(e[c], e[c + 3], weights[index]) * 31 >> 6);
+        outbuf[i] = color(rgb[0], rgb[1], rgb[2], 255);
+    }
+}
+
+int decode_bc6h(const uint8_t *data, const long w, const long h, uint32_t *image) {
+    return decode_blocks(data, w, h, 4, 4, 16, decode_bc6h_block, image);
+}
+
+/*
+ * BC7
+ */
+
+typedef struct {
+    int subsets;
+    int partition_bits;
+    int rotation_bits;
+    int index_selection_bits;
+    int color_bits;
+    int alpha_bits;
+    int endpoint_pbits;
+    int shared_pbits;
+    int index_bits;
+    int index2_bits;
+} Bc7Mode;
+
+static const Bc7Mode Bc7Modes[8] = {{3, 4, 0, 0, 4, 0, 1, 0, 3, 0}, {2, 6, 0, 0, 6, 0, 0, 1, 3, 0},
+                                    {3, 6, 0, 0, 5, 0, 0, 0, 2, 0}, {2, 6, 0, 0, 7, 0, 1, 0, 2, 0},
+                                    {1, 0, 2, 1, 5, 6, 0, 0, 2, 3}, {1, 0, 2, 0, 7, 8, 0, 0, 2, 2},
+                                    {1, 0, 0, 0, 7, 7, 1, 0, 4, 0}, {2, 6, 0, 0, 5, 5, 1, 0, 2, 0}};
+
+static inline uint_fast8_t expand_bits(const uint_fast8_t value, const int bits) {
+    const uint_fast8_t v = value << (8 - bits);
+    return v | v >> bits;
+}
+
+static void decode_bc7_block(const uint8_t *data, uint32_t *outbuf) {
+    BitStream bs = bitstream_init(data);
+    int mode_index = 0;
+    while (mode_index < 8 && !bitstream_read(&bs, 1))
+        mode_index++;
+    if (mode_index == 8) {
+        // invalid block is decoded as transparent black
+        memset(outbuf, 0, 64);
+        return;
+    }
+    const Bc7Mode *mode = Bc7Modes + mode_index;
+
+    const int partition = bitstream_read(&bs, mode->partition_bits);
+    const int rotation = bitstream_read(&bs, mode->rotation_bits);
+    const int index_selection = bitstream_read(&bs, mode->index_selection_bits);
+
+    // endpoints[subset * 2 + end][channel]
+    uint_fast8_t endpoints[6][4];
+    const int count = mode->subsets * 2;
+    for (int c = 0; c < 3; c++)
+        for (int e = 0; e < count; e++)
+            endpoints[e][c] = bitstream_read(&bs, mode->color_bits);
+    for (int e = 0; e < count; e++)
+        endpoints[e][3] = bitstream_read(&bs, mode->alpha_bits);
+
+    int color_bits = mode->color_bits, alpha_bits = mode->alpha_bits;
+    if (mode->endpoint_pbits || mode->shared_pbits) {
+        uint_fast8_t pbits[6];
+        if (mode->endpoint_pbits) {
+            for (int e = 0; e < count; e++)
+                pbits[e] = bitstream_read(&bs, 1);
+        } else {
+            for (int s = 0; s < mode->subsets; s++)
+                pbits[s * 2] = pbits[s * 2 + 1] = bitstream_read(&bs, 1);
+        }
+        for (int e = 0; e < count; e++)
+            for (int c = 0; c < 4; c++)
+                endpoints[e][c] = endpoints[e][c] << 1 | pbits[e];
+        color_bits++;
+        if (alpha_bits)
+            alpha_bits++;
+    }
+    for (int e = 0; e < count; e++) {
+        for (int c = 0; c < 3; c++)
+            endpoints[e][c] = expand_bits(endpoints[e][c], color_bits);
+        endpoints[e][3] = alpha_bits ? expand_bits(endpoints[e][3], alpha_bits) : 255;
+    }
+
+    uint_fast8_t indices[16], indices2[16];
+    for (int i = 0; i < 16; i++)
+        indices[i] = bitstream_read(&bs, mode->index_bits - is_anchor(mode->subsets, partition, i));
+    if (mode->index2_bits)
+        for (int i = 0; i < 16; i++)
+            indices2[i] = bitstream_read(&bs, mode->index2_bits - (i == 0));
+
+    for (int i = 0; i < 16; i++) {
+        const uint_fast8_t *e = endpoints[subset_of(mode->subsets, partition, i) * 2];
+        uint_fast8_t rgba[4];
+        if (mode->index2_bits) {
+            // the index selection bit swaps which index set is used for color and alpha
+            const uint_fast8_t *cw = WeightTable[index_selection ? mode->index2_bits : mode->index_bits];
+            const uint_fast8_t *aw = WeightTable[index_selection ? mode->index_bits : mode->index2_bits];
+            const uint_fast8_t ci = index_selection ? indices2[i] : indices[i];
+            const uint_fast8_t ai = index_selection ? indices[i] : indices2[i];
+            for (int c = 0; c < 3; c++)
+                rgba[c] = interpolate(e[c], e[c + 4], cw[ci]);
+            rgba[3] = interpolate(e[3], e[7], aw[ai]);
+        } else {
+            const uint_fast8_t w = WeightTable[mode->index_bits][indices[i]];
+            for (int c = 0; c < 4; c++)
+                rgba[c] = interpolate(e[c], e[c + 4], w);
+        }
+        if (rotation) {
+            const uint_fast8_t t = rgba[3];
+            rgba[3] = rgba[rotation - 1];
+            rgba[rotation - 1] = t;
+        }
+        outbuf[i] = color(rgba[0], rgba[1], rgba[2], rgba[3]);
+    }
+}
+
+int decode_bc7(const uint8_t *data, const long w, const long h, uint32_t *image) {
+    return decode_blocks(data, w, h, 4, 4, 16, decode_bc7_block, image);
+}
@@ -0,0 +1,9 @@
+#ifndef BPTC_H
+#define BPTC_H
+
+#include <stdint.h>
+
+int decode_bc6h(const uint8_t *, const long, const long, uint32_t *);
+int decode_bc7(const uint8_t *, const long, const long, uint32_t *);
+
+#endif /* end of include guard: BPTC_H */
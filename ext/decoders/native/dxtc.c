@@ -3,6 +3,7 @@
 #include <string.h>
 #include "color.h"
 #include "endianness.h"
+#include "parallel.h"
 
 static inline void decode_dxt1_block(const uint8_t *data, uint32_t *outbuf) {
     uint8_t r0, g0, b0, r1, g1, b1;
@@ -24,21 +25,12 @@ static inline void decode_dxt1_block(const uint8_t *data, uint32_t *outbuf) {
 }
 
 int decode_dxt1(const uint8_t *data, const long w, const long h, uint32_t *image) {
-    long num_blocks_x = (w + 3) / 4;
-    long num_blocks_y = (h + 3) / 4;
-    uint32_t buffer[16];
-    const uint8_t *d = data;
-    for (long by = 0; by < num_blocks_y; by++) {
-        for (long bx = 0; bx < num_blocks_x; bx++, d += 8) {
-            decode_dxt1_block(d, buffer);
-            copy_block_buffer(bx, by, w, h, 4, 4, buffer, image);
-        }
-    }
-    return 1;
+    return decode_blocks(data, w, h, 4, 4, 8, decode_dxt1_block, image);
 }
 
-static inline void decode_dxt5_block(const uint8_t *data, uint32_t *outbuf) {
-    uint_fast32_t a[8] = {data[0], data[1]};
+// Decodes an interpolated 8-bit channel block (DXT5 alpha / BC4 / BC5) into the given byte of each pixel.
+static inline void decode_channel_block(const uint8_t *data, const int channel, uint32_t *outbuf) {
+    uint_fast8_t a[8] = {data[0], data[1]};
     if (a[0] > a[1]) {
         a[2] = (a[0] * 6 + a[1]) / 7;
         a[3] = (a[0] * 5 + a[1] * 2) / 7;
@@ -54,24 +46,37 @@ static inline void decode_dxt5_block(const uint8_t *data, uint32_t *outbuf) {
         a[6] = 0;
         a[7] = 255;
     }
-    for (int i = 0; i < 8; i++)
-        a[i] = alpha_mask(a[i]);
-    decode_dxt1_block(data + 8, outbuf);
     uint_fast64_t d = lton64(*(uint64_t *)data) >> 16;
     for (int i = 0; i < 16; i++, d >>= 3)
-        outbuf[i] &= a[d & 7];
+        ((uint8_t *)(outbuf + i))[channel] = a[d & 7];
+}
+
+static inline void decode_dxt5_block(const uint8_t *data, uint32_t *outbuf) {
+    decode_dxt1_block(data + 8, outbuf);
+    decode_channel_block(data, 3, outbuf);
 }
 
 int decode_dxt5(const uint8_t *data, const long w, const long h, uint32_t *image) {
-    long num_blocks_x = (w + 3) / 4;
-    long num_blocks_y = (h + 3) / 4;
-    uint32_t buffer[16];
-    const uint8_t *d = data;
-    for (long by = 0; by < num_blocks_y; by++) {
-        for (long bx = 0; bx < num_blocks_x; bx++, d += 16) {
-            decode_dxt5_block(d, buffer);
-            copy_block_buffer(bx, by, w, h, 4, 4, buffer, image);
-        }
-    }
-    return 1;
+    return decode_blocks(data, w, h, 4, 4, 16, decode_dxt5_block, image);
+}
+
+static inline void decode_bc4_block(const uint8_t *data, uint32_t *outbuf) {
+    for (int i = 0; i < 16; i++)
+        outbuf[i] = color(0, 0, 0, 255);
+    decode_channel_block(data, 0, outbuf);
+}
+
+int decode_bc4(const uint8_t *data, const long w, const long h, uint32_t *image) {
+    return decode_blocks(data, w, h, 4, 4, 8, decode_bc4_block, image);
+}
+
+static inline void decode_bc5_block(const uint8_t *data, uint32_t *outbuf) {
+    for (int i = 0; i < 16; i++)
+        outbuf[i] = color(0, 0, 0, 255);
+    decode_channel_block(data, 0, outbuf);
+    decode_channel_block(data + 8, 1, outbuf);
+}
+
+int decode_bc5(const uint8_t *data, const long w, const long h, uint32_t *image) {
+    return decode_blocks(data, w, h, 4, 4, 16, decode_bc5_block, image);
 }
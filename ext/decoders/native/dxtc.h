@@ -5,5 +5,7 @@
 
 int decode_dxt1(const uint8_t *, const long, const long, uint32_t *);
 int decode_dxt5(const uint8_t *, const long, const long, uint32_t *);
+int decode_bc4(const uint8_t *, const long, const long, uint32_t *);
+int decode_bc5(const uint8_t *, const long, const long, uint32_t *);
 
 #endif /* end of include guard: DXTC_H */
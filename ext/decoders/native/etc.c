@@ -2,6 +2,16 @@
 #include <stdint.h>
 #include <string.h>
 #include "color.h"
+#include "parallel.h"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define ETC_SSSE3
+#include <tmmintrin.h>
+// picks the SSSE3 block decoder when the running CPU supports it
+#define SELECT_BLOCK_DECODER(f) (__builtin_cpu_supports("ssse3") ? f##_ssse3 : f)
+#else
+#define SELECT_BLOCK_DECODER(f) f
+#endif
 
 const uint_fast8_t WriteOrderTable[16] = {0, 4, 8, 12, 1, 5, 9, 13, 2, 6, 10, 14, 3, 7, 11, 15};
 const uint_fast8_t WriteOrderTableRev[16] = {15, 11, 7, 3, 14, 10, 6, 2, 13, 9, 5, 1, 12, 8, 4, 0};
@@ -37,9 +47,96 @@ static inline uint32_t applicate_color_raw(uint_fast8_t c[3]) {
     return color(c[0], c[1], c[2], 255);
 }
 
-static void decode_etc1_block(const uint8_t *data, uint32_t *outbuf) {
+// Writes the 16 pixels of a block whose colors are given as two sub-blocks (ETC1 / differential / individual).
+typedef void (*SubblockWriter)(uint_fast8_t[][3], const uint_fast8_t[2], const int, const uint_fast16_t,
+                               const uint_fast16_t, uint32_t *);
+// Writes the 16 pixels of a block whose colors are given as a palette of 4 colors (T / H).
+typedef void (*PaletteWriter)(const uint_fast32_t[4], const uint_fast16_t, const uint_fast16_t, uint32_t *);
+
+static void write_subblocks(uint_fast8_t c[][3], const uint_fast8_t code[2], const int flip, uint_fast16_t j,
+                            uint_fast16_t k, uint32_t *outbuf) {
+    const uint_fast8_t *table = Etc1SubblockTable[flip];
+    for (int i = 0; i < 16; i++, j >>= 1, k >>= 1) {
+        uint_fast8_t s = table[i];
+        uint_fast8_t m = Etc1ModifierTable[code[s]][j & 1];
+        outbuf[WriteOrderTable[i]] = applicate_color(c[s], k & 1 ? -m : m);
+    }
+}
+
+static void write_palette(const uint_fast32_t color_set[4], uint_fast16_t j, uint_fast16_t k, uint32_t *outbuf) {
+    for (int i = 0; i < 16; i++, j >>= 1, k >>= 1)
+        outbuf[WriteOrderTable[i]] = color_set[(k << 1 & 2) | (j & 1)];
+}
+
+#ifdef ETC_SSSE3
+/*
+ * SSSE3 kernels: each sub-block has only 4 possible colors, so they are computed once into a 16-byte palette
+ * and the pixels are gathered with pshufb. The palette index of a pixel is (msb << 1 | lsb), which is the
+ * same layout for the sub-block modes (+m0, +m1, -m0, -m1) and the T / H modes.
+ */
+
+// Returns the palette indices of the 16 pixels in row-major order.
+__attribute__((target("ssse3"))) static inline __m128i etc_indices_ssse3(const uint_fast16_t j,
+                                                                        const uint_fast16_t k) {
+    // pixel (x, y) takes bit x * 4 + y, i.e. bit (x & 1) * 4 + y of byte x >> 1
+    const __m128i byte_sel = _mm_setr_epi8(0, 0, 1, 1, 0, 0, 1, 1, 0, 0, 1, 1, 0, 0, 1, 1);
+    const __m128i bit_sel = _mm_setr_epi8(1, 16, 1, 16, 2, 32, 2, 32, 4, 64, 4, 64, 8, (char)128, 8, (char)128);
+    const __m128i lsb = _mm_shuffle_epi8(_mm_cvtsi32_si128((int)j), byte_sel);
+    const __m128i msb = _mm_shuffle_epi8(_mm_cvtsi32_si128((int)k), byte_sel);
+    const __m128i l = _mm_cmpeq_epi8(_mm_and_si128(lsb, bit_sel), bit_sel);
+    const __m128i m = _mm_cmpeq_epi8(_mm_and_si128(msb, bit_sel), bit_sel);
+    return _mm_or_si128(_mm_and_si128(l, _mm_set1_epi8(1)), _mm_and_si128(m, _mm_set1_epi8(2)));
+}
+
+// Writes a block from two palettes; flip == 0 splits the block into left / right, otherwise into top / bottom.
+__attribute__((target("ssse3"))) static inline void write_palettes_ssse3(const __m128i pal0, const __m128i pal1,
+                                                                        const int flip, const uint_fast16_t j,
+                                                                        const uint_fast16_t k, uint32_t *outbuf) {
+    const __m128i index = etc_indices_ssse3(j, k);
+    const __m128i offset = _mm_setr_epi8(0, 1, 2, 3, 0, 1, 2, 3, 0, 1, 2, 3, 0, 1, 2, 3);
+    for (int y = 0; y < 4; y++) {
+        const char p = (char)(y * 4);
+        const __m128i spread = _mm_setr_epi8(p, p, p, p, p + 1, p + 1, p + 1, p + 1, p + 2, p + 2, p + 2, p + 2,
+                                             p + 3, p + 3, p + 3, p + 3);
+        __m128i mask = _mm_shuffle_epi8(index, spread);
+        mask = _mm_add_epi8(_mm_slli_epi16(mask, 2), offset);
+        const __m128i c0 = _mm_shuffle_epi8(pal0, mask);
+        const __m128i c1 = _mm_shuffle_epi8(pal1, mask);
+        __m128i row;
+        if (flip)
+            row = y < 2 ? c0 : c1;
+        else
+            row = _mm_castpd_si128(_mm_move_sd(_mm_castsi128_pd(c1), _mm_castsi128_pd(c0)));
+        _mm_storeu_si128((__m128i *)(outbuf + y * 4), row);
+    }
+}
+
+__attribute__((target("ssse3"))) static inline __m128i subblock_palette_ssse3(const uint_fast8_t c[3],
+                                                                             const uint_fast8_t code) {
+    const int16_t m0 = Etc1ModifierTable[code][0], m1 = Etc1ModifierTable[code][1];
+    const __m128i base = _mm_setr_epi16(c[0], c[1], c[2], 255, c[0], c[1], c[2], 255);
+    const __m128i mod = _mm_setr_epi16(m0, m0, m0, 0, m1, m1, m1, 0);
+    return _mm_packus_epi16(_mm_add_epi16(base, mod), _mm_sub_epi16(base, mod));
+}
+
+__attribute__((target("ssse3"))) static void write_subblocks_ssse3(uint_fast8_t c[][3], const uint_fast8_t code[2],
+                                                                  const int flip, const uint_fast16_t j,
+                                                                  const uint_fast16_t k, uint32_t *outbuf) {
+    write_palettes_ssse3(subblock_palette_ssse3(c[0], code[0]), subblock_palette_ssse3(c[1], code[1]), flip, j,
+                         k, outbuf);
+}
+
+__attribute__((target("ssse3"))) static void write_palette_ssse3(const uint_fast32_t color_set[4],
+                                                                const uint_fast16_t j, const uint_fast16_t k,
+                                                                uint32_t *outbuf) {
+    const __m128i pal = _mm_setr_epi32(color_set[0], color_set[1], color_set[2], color_set[3]);
+    write_palettes_ssse3(pal, pal, 0, j, k, outbuf);
+}
+#endif /* ETC_SSSE3 */
+
+static inline void decode_etc1_block_with(const uint8_t *data, const SubblockWriter write_subblocks,
+                                          uint32_t *outbuf) {
     const uint_fast8_t code[2] = {data[3] >> 5, data[3] >> 2 & 7};  // Table codewords
-    const uint_fast8_t *table = Etc1SubblockTable[data[3] & 1];
     uint_fast8_t c[2][3];
     if (data[3] & 2) {
         // diff bit == 1
@@ -65,18 +162,15 @@ static void decode_etc1_block(const uint8_t *data, uint32_t *outbuf) {
         c[1][2] = (data[2] & 0x0f) | data[2] << 4;
     }
 
-    uint_fast16_t j = data[6] << 8 | data[7];  // less significant pixel index bits
-    uint_fast16_t k = data[4] << 8 | data[5];  // more significant pixel index bits
-    for (int i = 0; i < 16; i++, j >>= 1, k >>= 1) {
-        uint_fast8_t s = table[i];
-        uint_fast8_t m = Etc1ModifierTable[code[s]][j & 1];
-        outbuf[WriteOrderTable[i]] = applicate_color(c[s], k & 1 ? -m : m);
-    }
+    const uint_fast16_t j = data[6] << 8 | data[7];  // less significant pixel index bits
+    const uint_fast16_t k = data[4] << 8 | data[5];  // more significant pixel index bits
+    write_subblocks(c, code, data[3] & 1, j, k, outbuf);
 }
 
-static void decode_etc2_block(const uint8_t *data, uint32_t *outbuf) {
-    uint_fast16_t j = data[6] << 8 | data[7];  // 15 -> 0
-    uint_fast32_t k = data[4] << 8 | data[5];  // 31 -> 16
+static inline void decode_etc2_block_with(const uint8_t *data, const SubblockWriter write_subblocks,
+                                          const PaletteWriter write_palette, uint32_t *outbuf) {
+    const uint_fast16_t j = data[6] << 8 | data[7];  // 15 -> 0
+    const uint_fast16_t k = data[4] << 8 | data[5];  // 31 -> 16
     uint_fast8_t c[3][3] = {};
 
     if (data[3] & 2) {
@@ -98,9 +192,7 @@ static void decode_etc2_block(const uint8_t *data, uint32_t *outbuf) {
             const uint_fast8_t d = Etc2DistanceTable[(data[3] >> 1 & 6) | (data[3] & 1)];
             uint_fast32_t color_set[4] = {applicate_color_raw(c[0]), applicate_color(c[1], d),
                                           applicate_color_raw(c[1]), applicate_color(c[1], -d)};
-            k <<= 1;
-            for (int i = 0; i < 16; i++, j >>= 1, k >>= 1)
-                outbuf[WriteOrderTable[i]] = color_set[(k & 2) | (j & 1)];
+            write_palette(color_set, j, k, outbuf);
         } else if (g + dg < 0 || g + dg > 255) {
             // H
             c[0][0] = (data[0] << 1 & 0xf0) | (data[0] >> 3 & 0xf);
@@ -119,9 +211,7 @@ static void decode_etc2_block(const uint8_t *data, uint32_t *outbuf) {
             d = Etc2DistanceTable[d];
             uint_fast32_t color_set[4] = {applicate_color(c[0], d), applicate_color(c[0], -d), applicate_color(c[1], d),
                                           applicate_color(c[1], -d)};
-            k <<= 1;
-            for (int i = 0; i < 16; i++, j >>= 1, k >>= 1)
-                outbuf[WriteOrderTable[i]] = color_set[(k & 2) | (j & 1)];
+            write_palette(color_set, j, k, outbuf);
         } else if (b + db < 0 || b + db > 255) {
             // planar
             c[0][0] = (data[0] << 1 & 0xfc) | (data[0] >> 5 & 3);
@@ -146,7 +236,6 @@ static void decode_etc2_block(const uint8_t *data, uint32_t *outbuf) {
         } else {
             // differential
             const uint_fast8_t code[2] = {data[3] >> 5, data[3] >> 2 & 7};
-            const uint_fast8_t *table = Etc1SubblockTable[data[3] & 1];
             c[0][0] = r | r >> 5;
             c[0][1] = g | g >> 5;
             c[0][2] = b | b >> 5;
@@ -156,30 +245,39 @@ static void decode_etc2_block(const uint8_t *data, uint32_t *outbuf) {
             c[1][0] |= c[1][0] >> 5;
             c[1][1] |= c[1][1] >> 5;
             c[1][2] |= c[1][2] >> 5;
-            for (int i = 0; i < 16; i++, j >>= 1, k >>= 1) {
-                uint_fast8_t s = table[i];
-                uint_fast8_t m = Etc1ModifierTable[code[s]][j & 1];
-                outbuf[WriteOrderTable[i]] = applicate_color(c[s], k & 1 ? -m : m);
-            }
+            write_subblocks(c, code, data[3] & 1, j, k, outbuf);
         }
     } else {
         // individual (diff bit == 0)
         const uint_fast8_t code[2] = {data[3] >> 5, data[3] >> 2 & 7};
-        const uint_fast8_t *table = Etc1SubblockTable[data[3] & 1];
         c[0][0] = (data[0] & 0xf0) | data[0] >> 4;
         c[1][0] = (data[0] & 0x0f) | data[0] << 4;
         c[0][1] = (data[1] & 0xf0) | data[1] >> 4;
         c[1][1] = (data[1] & 0x0f) | data[1] << 4;
         c[0][2] = (data[2] & 0xf0) | data[2] >> 4;
         c[1][2] = (data[2] & 0x0f) | data[2] << 4;
-        for (int i = 0; i < 16; i++, j >>= 1, k >>= 1) {
-            uint_fast8_t s = table[i];
-            uint_fast8_t m = Etc1ModifierTable[code[s]][j & 1];
-            outbuf[WriteOrderTable[i]] = applicate_color(c[s], k & 1 ? -m : m);
-        }
+        write_subblocks(c, code, data[3] & 1, j, k, outbuf);
     }
 }
 
+static void decode_etc1_block(const uint8_t *data, uint32_t *outbuf) {
+    decode_etc1_block_with(data, write_subblocks, outbuf);
+}
+
+static void decode_etc2_block(const uint8_t *data, uint32_t *outbuf) {
+    decode_etc2_block_with(data, write_subblocks, write_palette, outbuf);
+}
+
+#ifdef ETC_SSSE3
+__attribute__((target("ssse3"))) static void decode_etc1_block_ssse3(const uint8_t *data, uint32_t *outbuf) {
+    decode_etc1_block_with(data, write_subblocks_ssse3, outbuf);
+}
+
+__attribute__((target("ssse3"))) static void decode_etc2_block_ssse3(const uint8_t *data, uint32_t *outbuf) {
+    decode_etc2_block_with(data, write_subblocks_ssse3, write_palette_ssse3, outbuf);
+}
+#endif /* ETC_SSSE3 */
+
 static void decode_etc2a1_block(const uint8_t *data, uint32_t *outbuf) {
     uint_fast16_t j = data[6] << 8 | data[7];  // 15 -> 0
     uint_fast32_t k = data[4] << 8 | data[5];  // 31 -> 16
@@ -319,125 +417,74 @@ static void decode_eac_signed_block(const uint8_t *data, int color, uint32_t *ou
     }
 }
 
+static void decode_etc2a8_rgba_block(const uint8_t *data, uint32_t *outbuf) {
+    decode_etc2_block(data + 8, outbuf);
+    decode_etc2a8_block(data, outbuf);
+}
+
+#ifdef ETC_SSSE3
+__attribute__((target("ssse3"))) static void decode_etc2a8_rgba_block_ssse3(const uint8_t *data,
+                                                                           uint32_t *outbuf) {
+    decode_etc2_block_ssse3(data + 8, outbuf);
+    decode_etc2a8_block(data, outbuf);
+}
+#endif /* ETC_SSSE3 */
+
+static inline void clear_eac_block(uint32_t *outbuf) {
+    for (int i = 0; i < 16; i++)
+        outbuf[i] = color(0, 0, 0, 255);
+}
+
+static void decode_eacr_block(const uint8_t *data, uint32_t *outbuf) {
+    clear_eac_block(outbuf);
+    decode_eac_block(data, 0, outbuf);
+}
+
+static void decode_eacr_signed_block(const uint8_t *data, uint32_t *outbuf) {
+    clear_eac_block(outbuf);
+    decode_eac_signed_block(data, 0, outbuf);
+}
+
+static void decode_eacrg_block(const uint8_t *data, uint32_t *outbuf) {
+    clear_eac_block(outbuf);
+    decode_eac_block(data, 0, outbuf);
+    decode_eac_block(data + 8, 1, outbuf);
+}
+
+static void decode_eacrg_signed_block(const uint8_t *data, uint32_t *outbuf) {
+    clear_eac_block(outbuf);
+    decode_eac_signed_block(data, 0, outbuf);
+    decode_eac_signed_block(data + 8, 1, outbuf);
+}
+
 int decode_etc1(const uint8_t *data, const long w, const long h, uint32_t *image) {
-    long num_blocks_x = (w + 3) / 4;
-    long num_blocks_y = (h + 3) / 4;
-    uint32_t buffer[16];
-    for (long by = 0; by < num_blocks_y; by++) {
-        for (long bx = 0; bx < num_blocks_x; bx++, data += 8) {
-            decode_etc1_block(data, buffer);
-            copy_block_buffer(bx, by, w, h, 4, 4, buffer, image);
-        }
-    }
-    return 1;
+    return decode_blocks(data, w, h, 4, 4, 8, SELECT_BLOCK_DECODER(decode_etc1_block), image);
 }
 
 int decode_etc2(const uint8_t *data, const long w, const long h, uint32_t *image) {
-    long num_blocks_x = (w + 3) / 4;
-    long num_blocks_y = (h + 3) / 4;
-    uint32_t buffer[16];
-    for (long by = 0; by < num_blocks_y; by++) {
-        for (long bx = 0; bx < num_blocks_x; bx++, data += 8) {
-            decode_etc2_block(data, buffer);
-            copy_block_buffer(bx, by, w, h, 4, 4, buffer, image);
-        }
-    }
-    return 1;
+    return decode_blocks(data, w, h, 4, 4, 8, SELECT_BLOCK_DECODER(decode_etc2_block), image);
 }
 
 int decode_etc2a1(const uint8_t *data, const long w, const long h, uint32_t *image) {
-    long num_blocks_x = (w + 3) / 4;
-    long num_blocks_y = (h + 3) / 4;
-    uint32_t buffer[16];
-    for (long by = 0; by < num_blocks_y; by++) {
-        for (long bx = 0; bx < num_blocks_x; bx++, data += 8) {
-            decode_etc2a1_block(data, buffer);
-            copy_block_buffer(bx, by, w, h, 4, 4, buffer, image);
-        }
-    }
-    return 1;
+    return decode_blocks(data, w, h, 4, 4, 8, decode_etc2a1_block, image);
 }
 
 int decode_etc2a8(const uint8_t *data, const long w, const long h, uint32_t *image) {
-    long num_blocks_x = (w + 3) / 4;
-    long num_blocks_y = (h + 3) / 4;
-    uint32_t buffer[16];
-    for (long by = 0; by < num_blocks_y; by++) {
-        for (long bx = 0; bx < num_blocks_x; bx++, data += 16) {
-            decode_etc2_block(data + 8, buffer);
-            decode_etc2a8_block(data, buffer);
-            copy_block_buffer(bx, by, w, h, 4, 4, buffer, image);
-        }
-    }
-    return 1;
+    return decode_blocks(data, w, h, 4, 4, 16, SELECT_BLOCK_DECODER(decode_etc2a8_rgba_block), image);
 }
 
 int decode_eacr(const uint8_t *data, const long w, const long h, uint32_t *image) {
-    long num_blocks_x = (w + 3) / 4;
-    long num_blocks_y = (h + 3) / 4;
-    uint32_t buffer[16];
-    uint32_t base_buffer[16];
-    for (int i = 0; i < 16; i++)
-        base_buffer[i] = color(0, 0, 0, 255);
-    for (long by = 0; by < num_blocks_y; by++) {
-        for (long bx = 0; bx < num_blocks_x; bx++, data += 8) {
-            memcpy(buffer, base_buffer, sizeof(buffer));
-            decode_eac_block(data, 0, buffer);
-            copy_block_buffer(bx, by, w, h, 4, 4, buffer, image);
-        }
-    }
-    return 1;
+    return decode_blocks(data, w, h, 4, 4, 8, decode_eacr_block, image);
 }
 
 int decode_eacr_signed(const uint8_t *data, const long w, const long h, uint32_t *image) {
-    long num_blocks_x = (w + 3) / 4;
-    long num_blocks_y = (h + 3) / 4;
-    uint32_t buffer[16];
-    uint32_t base_buffer[16];
-    for (int i = 0; i < 16; i++)
-        base_buffer[i] = color(0, 0, 0, 255);
-    for (long by = 0; by < num_blocks_y; by++) {
-        for (long bx = 0; bx < num_blocks_x; bx++, data += 8) {
-            memcpy(buffer, base_buffer, sizeof(buffer));
-            decode_eac_signed_block(data, 0, buffer);
-            copy_block_buffer(bx, by, w, h, 4, 4, buffer, image);
-        }
-    }
-    return 1;
+    return decode_blocks(data, w, h, 4, 4, 8, decode_eacr_signed_block, image);
 }
 
 int decode_eacrg(const uint8_t *data, const long w, const long h, uint32_t *image) {
-    long num_blocks_x = (w + 3) / 4;
-    long num_blocks_y = (h + 3) / 4;
-    uint32_t buffer[16];
-    uint32_t base_buffer[16];
-    for (int i = 0; i < 16; i++)
-        base_buffer[i] = color(0, 0, 0, 255);
-    for (long by = 0; by < num_blocks_y; by++) {
-        for (long bx = 0; bx < num_blocks_x; bx++, data += 16) {
-            memcpy(buffer, base_buffer, sizeof(buffer));
-            decode_eac_block(data, 0, buffer);
-            decode_eac_block(data + 8, 1, buffer);
-            copy_block_buffer(bx, by, w, h, 4, 4, buffer, image);
-        }
-    }
-    return 1;
+    return decode_blocks(data, w, h, 4, 4, 16, decode_eacrg_block, image);
 }
 
 int decode_eacrg_signed(const uint8_t *data, const long w, const long h, uint32_t *image) {
-    long num_blocks_x = (w + 3) / 4;
-    long num_blocks_y = (h + 3) / 4;
-    uint32_t buffer[16];
-    uint32_t base_buffer[16];
-    for (int i = 0; i < 16; i++)
-        base_buffer[i] = color(0, 0, 0, 255);
-    for (long by = 0; by < num_blocks_y; by++) {
-        for (long bx = 0; bx < num_blocks_x; bx++, data += 16) {
-            memcpy(buffer, base_buffer, sizeof(buffer));
-            decode_eac_signed_block(data, 0, buffer);
-            decode_eac_signed_block(data + 8, 1, buffer);
-            copy_block_buffer(bx, by, w, h, 4, 4, buffer, image);
-        }
-    }
-    return 1;
+    return decode_blocks(data, w, h, 4, 4, 16, decode_eacrg_signed_block, image);
 }
@@ -1,11 +1,66 @@
 # frozen_string_literal: true
 
+require 'json'
 require 'mkmf'
 
+# Compiles the bundled TypeTrees into a C header embedded in the extension,
+# which has a string table, nodes of all trees and trees sorted by class ID and hash
+def write_typetree_db(dir, file)
+  strings = {}
+  buffer = String.new(encoding: Encoding::BINARY)
+  offset = lambda do |s|
+    next 'DB_NO_STRING' if s.nil?
+
+    strings[s] ||= buffer.bytesize.tap {buffer << s.b << "\0"}
+  end
+  files = Dir[File.join(dir, '*', '*.json')].select {|f| File.basename(f, '.json').match?(/\A\h{32}\z/)}
+  trees = files.map do |f|
+    [File.basename(File.dirname(f)).to_i, [File.basename(f, '.json')].pack('H*'), JSON.parse(File.read(f))['nodes']]
+  end.sort_by {|class_id, hash, _| [class_id, hash]}
+
+  nodes = []
+  tree_lines = trees.map do |class_id, hash, tree_nodes|
+    first = nodes.size
+    tree_nodes.each do |n|
+      v18meta = n['v18meta'] ? "#{n['v18meta']}ULL" : '0'
+      nodes << "{#{offset.(n['type'])}, #{offset.(n['name'])}, #{n['size']}, #{n['flags']}U, #{v18meta}, " \
+               "#{n['version']}, #{n['level'] || n['depth']}, #{n['is_array'] ? 1 : 0}, #{n['v18meta'] ? 1 : 0}}"
+    end
+    "{#{class_id}, {#{hash.bytes.join(', ')}}, #{first}, #{tree_nodes.size}}"
+  end
+
+  # a literal for each string, so that an escaped NUL is not followed by digits
+  string_lines = strings.keys.map do |s|
+    escaped = s.b.gsub(/[^ !#-\[\]-~]|\?/n) {|c| c == '?' ? '\?' : format('\\%03o', c.ord)}
+    "\"#{escaped}\\0\""
+  end
+  File.write(file, <<~HEADER)
+    // generated from lib/mikunyan/typetrees by extconf.rb
+    #define DB_NUM_TREES #{trees.size}
+    static const char db_strings[] =
+        #{string_lines.empty? ? '""' : string_lines.join("\n    ")};
+    static const DbNode db_nodes[] = {
+        #{nodes.empty? ? '{0}' : nodes.join(",\n    ")}
+    };
+    static const DbTree db_trees[] = {
+        #{tree_lines.empty? ? '{0}' : tree_lines.join(",\n    ")}
+    };
+  HEADER
+end
+
 append_cppflags('-std=c11')
 append_cppflags('-O2')
 append_cppflags('-Wall')
 append_cppflags('-Wextra')
 append_cppflags('-Wvla')
 
+have_header('pthread.h') && have_library('pthread', 'pthread_create')
+have_header('sys/mman.h')
+have_func('rb_enc_interned_str', 'ruby/encoding.h')
+abort 'zlib is required' unless have_header('zlib.h') && have_library('z', 'deflate')
+have_header('lzma.h') && have_library('lzma', 'lzma_raw_decoder')
+
+write_typetree_db(File.expand_path('../../../lib/mikunyan/typetrees', __dir__), 'typetree_db.h')
+$distcleanfiles << 'typetree_db.h'
+
 create_makefile('mikunyan/decoders/native')
@@ -1,19 +1,30 @@
 #include <ruby.h>
+#include <ruby/thread.h>
 #include <stdint.h>
 #include <stdlib.h>
 #include "astc.h"
+#include "binary_reader.h"
+#include "bptc.h"
 #include "dxtc.h"
+#include "endianness.h"
 #include "etc.h"
+#include "mapped_file.h"
+#include "object_parser.h"
+#include "parallel.h"
+#include "png.h"
 #include "pvrtc.h"
 #include "rgb.h"
+#include "type_tree.h"
+#include "unityfs.h"
 
-const char *error_msg = NULL;
+_Thread_local const char *error_msg = NULL;
 
-#define DECODE_CHECK(call)                                                                  \
-    if (!call) {                                                                            \
-        rb_raise(rb_eRuntimeError, "%s", error_msg ? error_msg : "unknown internal error"); \
-        error_msg = NULL;                                                                   \
-        return Qnil;                                                                        \
+#define DECODE_CHECK(call)                                                    \
+    if (!call) {                                                              \
+        const char *msg = error_msg ? error_msg : "unknown internal error";   \
+        error_msg = NULL;                                                     \
+        rb_raise(rb_eRuntimeError, "%s", msg);                                \
+        return Qnil;                                                          \
     }
 
 static int check_str_len(VALUE data, long len, long unit) {
@@ -29,16 +40,218 @@ static int check_str_len_block(VALUE data, long w, long h, long bw, long bh, lon
     return check_str_len(data, size, unit);
 }
 
-static VALUE rb_alloc_rgb(long n) {
-    VALUE ret = rb_str_buf_new(n * 3);
-    rb_str_set_len(ret, n * 3);
-    return ret;
+/*
+ * Returns the string to write len bytes of output into
+ * A new string is allocated if rb_dest is nil. Otherwise rb_dest is reused, and it must be a mutable string which
+ * already has len bytes after rb_offset.
+ */
+static VALUE rb_alloc_output(VALUE rb_dest, VALUE rb_offset, long len, long *offset) {
+    if (NIL_P(rb_dest)) {
+        VALUE ret = rb_str_buf_new(len);
+        rb_str_set_len(ret, len);
+        *offset = 0;
+        return ret;
+    }
+    StringValue(rb_dest);
+    rb_check_frozen(rb_dest);
+    *offset = NIL_P(rb_offset) ? 0 : NUM2LONG(rb_offset);
+    if (*offset < 0 || RSTRING_LEN(rb_dest) - *offset < len)
+        rb_raise(rb_eArgError, "Destination buffer is not large enough.");
+    return rb_dest;
 }
 
-static VALUE rb_alloc_rgba(long n) {
-    VALUE ret = rb_str_buf_new(n * 4);
-    rb_str_set_len(ret, n * 4);
-    return ret;
+/*
+ * Reads the arguments of a decoder which takes `required` arguments followed by optional rb_dest and rb_offset
+ */
+static void scan_output_args(int argc, VALUE *argv, int required, VALUE *rb_dest, VALUE *rb_offset) {
+    rb_check_arity(argc, required, required + 2);
+    *rb_dest = argc > required ? argv[required] : Qnil;
+    *rb_offset = argc > required + 1 ? argv[required + 1] : Qnil;
+}
+
+static VALUE rb_alloc_rgb(VALUE rb_dest, VALUE rb_offset, long n, long *offset) {
+    return rb_alloc_output(rb_dest, rb_offset, n * 3, offset);
+}
+
+static VALUE rb_alloc_rgba(VALUE rb_dest, VALUE rb_offset, long n, long *offset) {
+    return rb_alloc_output(rb_dest, rb_offset, n * 4, offset);
+}
+
+typedef struct {
+    const void *data;
+    long size;
+    long w;
+    long h;
+    int bw;
+    int bh;
+    int flag;
+    int bpp;
+    void *image;
+} DecodeArgs;
+
+typedef int (*DecodeFunc)(const DecodeArgs *);
+
+typedef struct {
+    DecodeFunc func;
+    const DecodeArgs *args;
+    int result;
+} DecodeCall;
+
+static void *decode_nogvl(void *ptr) {
+    DecodeCall *call = (DecodeCall *)ptr;
+    call->result = call->func(call->args);
+    return NULL;
+}
+
+/*
+ * Runs a decoder without the GVL
+ * The input is pinned by a frozen shared copy so that other threads cannot modify it while decoding.
+ * The output is made independent of any shared buffer (including the input) and temporarily locked,
+ * so that it cannot be resized or reused by another decoder while decoding.
+ */
+static int decode_without_gvl(DecodeFunc func, DecodeArgs *args, VALUE rb_data, VALUE rb_image, long offset) {
+    VALUE data = rb_str_new_frozen(rb_data);
+    rb_str_modify(rb_image);
+    rb_str_locktmp(rb_image);
+    args->data = RSTRING_PTR(data);
+    args->image = RSTRING_PTR(rb_image) + offset;
+    DecodeCall call = {func, args, 0};
+    rb_thread_call_without_gvl(decode_nogvl, &call, NULL, NULL);
+    rb_str_unlocktmp(rb_image);
+    RB_GC_GUARD(data);
+    return call.result;
+}
+
+static int call_decode_a8(const DecodeArgs *a) {
+    return decode_a8(a->data, a->size, a->image);
+}
+
+static int call_decode_r8(const DecodeArgs *a) {
+    return decode_r8(a->data, a->size, a->image);
+}
+
+static int call_decode_r16(const DecodeArgs *a) {
+    return decode_r16(a->data, a->size, a->flag, a->image);
+}
+
+static int call_decode_rgb565(const DecodeArgs *a) {
+    return decode_rgb565(a->data, a->size, a->flag, a->image);
+}
+
+static int call_decode_rhalf(const DecodeArgs *a) {
+    return decode_rhalf(a->data, a->size, a->flag, a->image);
+}
+
+static int call_decode_rghalf(const DecodeArgs *a) {
+    return decode_rghalf(a->data, a->size, a->flag, a->image);
+}
+
+static int call_decode_rgbahalf(const DecodeArgs *a) {
+    return decode_rgbahalf(a->data, a->size, a->flag, a->image);
+}
+
+static int call_decode_argb32(const DecodeArgs *a) {
+    return decode_argb32(a->data, a->w, a->h, a->image);
+}
+
+static int call_decode_bgra32(const DecodeArgs *a) {
+    return decode_bgra32(a->data, a->w, a->h, a->image);
+}
+
+static int call_decode_argb4444(const DecodeArgs *a) {
+    return decode_argb4444(a->data, a->w, a->h, a->flag, a->image);
+}
+
+static int call_decode_rgba4444(const DecodeArgs *a) {
+    return decode_rgba4444(a->data, a->w, a->h, a->flag, a->image);
+}
+
+static int call_decode_rg16(const DecodeArgs *a) {
+    return decode_rg16(a->data, a->w, a->h, a->image);
+}
+
+static int call_decode_rfloat(const DecodeArgs *a) {
+    return decode_rfloat(a->data, a->w, a->h, a->flag, a->image);
+}
+
+static int call_decode_rgfloat(const DecodeArgs *a) {
+    return decode_rgfloat(a->data, a->w, a->h, a->flag, a->image);
+}
+
+static int call_decode_rgbafloat(const DecodeArgs *a) {
+    return decode_rgbafloat(a->data, a->w, a->h, a->flag, a->image);
+}
+
+static int call_decode_rgb9e5float(const DecodeArgs *a) {
+    return decode_rgb9e5float(a->data, a->w, a->h, a->flag, a->image);
+}
+
+static int call_flip_image(const DecodeArgs *a) {
+    return flip_image(a->data, a->w, a->h, a->bpp, a->image);
+}
+
+static int call_decode_etc1(const DecodeArgs *a) {
+    return decode_etc1(a->data, a->w, a->h, a->image);
+}
+
+static int call_decode_etc2(const DecodeArgs *a) {
+    return decode_etc2(a->data, a->w, a->h, a->image);
+}
+
+static int call_decode_etc2a1(const DecodeArgs *a) {
+    return decode_etc2a1(a->data, a->w, a->h, a->image);
+}
+
+static int call_decode_etc2a8(const DecodeArgs *a) {
+    return decode_etc2a8(a->data, a->w, a->h, a->image);
+}
+
+static int call_decode_eacr(const DecodeArgs *a) {
+    return decode_eacr(a->data, a->w, a->h, a->image);
+}
+
+static int call_decode_eacr_signed(const DecodeArgs *a) {
+    return decode_eacr_signed(a->data, a->w, a->h, a->image);
+}
+
+static int call_decode_eacrg(const DecodeArgs *a) {
+    return decode_eacrg(a->data, a->w, a->h, a->image);
+}
+
+static int call_decode_eacrg_signed(const DecodeArgs *a) {
+    return decode_eacrg_signed(a->data, a->w, a->h, a->image);
+}
+
+static int call_decode_astc(const DecodeArgs *a) {
+    return decode_astc(a->data, a->w, a->h, a->bw, a->bh, a->image);
+}
+
+static int call_decode_dxt1(const DecodeArgs *a) {
+    return decode_dxt1(a->data, a->w, a->h, a->image);
+}
+
+static int call_decode_dxt5(const DecodeArgs *a) {
+    return decode_dxt5(a->data, a->w, a->h, a->image);
+}
+
+static int call_decode_bc4(const DecodeArgs *a) {
+    return decode_bc4(a->data, a->w, a->h, a->image);
+}
+
+static int call_decode_bc5(const DecodeArgs *a) {
+    return decode_bc5(a->data, a->w, a->h, a->image);
+}
+
+static int call_decode_bc6h(const DecodeArgs *a) {
+    return decode_bc6h(a->data, a->w, a->h, a->image);
+}
+
+static int call_decode_bc7(const DecodeArgs *a) {
+    return decode_bc7(a->data, a->w, a->h, a->image);
+}
+
+static int call_decode_pvrtc(const DecodeArgs *a) {
+    return decode_pvrtc(a->data, a->w, a->h, a->image, a->flag);
 }
 
 /*
@@ -47,14 +260,21 @@ static VALUE rb_alloc_rgba(long n) {
  *
  * @param [String] rb_data binary to decode
  * @param [Integer] rb_size width * height
- * @return [String] decoded rgb binary
+ * @param [String, nil] rb_dest string to write the result into, or nil to allocate a new one
+ * @param [Integer, nil] rb_offset byte offset in rb_dest to write the result at
+ * @return [String] decoded rgb binary (rb_dest if given)
  */
-static VALUE rb_decode_a8(VALUE self, VALUE rb_data, VALUE rb_size) {
+static VALUE rb_decode_a8(int argc, VALUE *argv, VALUE self) {
+    VALUE rb_dest, rb_offset;
+    scan_output_args(argc, argv, 2, &rb_dest, &rb_offset);
+    VALUE rb_data = argv[0], rb_size = argv[1];
     long size = FIX2LONG(rb_size);
     if (!check_str_len(rb_data, size, 1))
         return Qnil;
-    VALUE ret = rb_alloc_rgb(size);
-    if (!decode_a8((uint8_t *)RSTRING_PTR(rb_data), size, (uint8_t *)RSTRING_PTR(ret)))
+    long offset;
+    VALUE ret = rb_alloc_rgb(rb_dest, rb_offset, size, &offset);
+    DecodeArgs args = {.size = size};
+    if (!decode_without_gvl(call_decode_a8, &args, rb_data, ret, offset))
         return Qnil;
     return ret;
 }
@@ -65,14 +285,21 @@ static VALUE rb_decode_a8(VALUE self, VALUE rb_data, VALUE rb_size) {
  *
  * @param [String] rb_data binary to decode
  * @param [Integer] rb_size width * height
- * @return [String] decoded rgb binary
+ * @param [String, nil] rb_dest string to write the result into, or nil to allocate a new one
+ * @param [Integer, nil] rb_offset byte offset in rb_dest to write the result at
+ * @return [String] decoded rgb binary (rb_dest if given)
  */
-static VALUE rb_decode_r8(VALUE self, VALUE rb_data, VALUE rb_size) {
+static VALUE rb_decode_r8(int argc, VALUE *argv, VALUE self) {
+    VALUE rb_dest, rb_offset;
+    scan_output_args(argc, argv, 2, &rb_dest, &rb_offset);
+    VALUE rb_data = argv[0], rb_size = argv[1];
     long size = FIX2LONG(rb_size);
     if (!check_str_len(rb_data, size, 1))
         return Qnil;
-    VALUE ret = rb_alloc_rgb(size);
-    if (!decode_r8((uint8_t *)RSTRING_PTR(rb_data), size, (uint8_t *)RSTRING_PTR(ret)))
+    long offset;
+    VALUE ret = rb_alloc_rgb(rb_dest, rb_offset, size, &offset);
+    DecodeArgs args = {.size = size};
+    if (!decode_without_gvl(call_decode_r8, &args, rb_data, ret, offset))
         return Qnil;
     return ret;
 }
@@ -84,14 +311,21 @@ static VALUE rb_decode_r8(VALUE self, VALUE rb_data, VALUE rb_size) {
  * @param [String] rb_data binary to decode
  * @param [Integer] rb_size width * height
  * @param [Boolean] rb_big whether input data are big endian
- * @return [String] decoded rgb binary
+ * @param [String, nil] rb_dest string to write the result into, or nil to allocate a new one
+ * @param [Integer, nil] rb_offset byte offset in rb_dest to write the result at
+ * @return [String] decoded rgb binary (rb_dest if given)
  */
-static VALUE rb_decode_r16(VALUE self, VALUE rb_data, VALUE rb_size, VALUE rb_big) {
+static VALUE rb_decode_r16(int argc, VALUE *argv, VALUE self) {
+    VALUE rb_dest, rb_offset;
+    scan_output_args(argc, argv, 3, &rb_dest, &rb_offset);
+    VALUE rb_data = argv[0], rb_size = argv[1], rb_big = argv[2];
     long size = FIX2LONG(rb_size);
     if (!check_str_len(rb_data, size, 2))
         return Qnil;
-    VALUE ret = rb_alloc_rgb(size);
-    if (!decode_r16((uint8_t *)RSTRING_PTR(rb_data), size, RTEST(rb_big), (uint8_t *)RSTRING_PTR(ret)))
+    long offset;
+    VALUE ret = rb_alloc_rgb(rb_dest, rb_offset, size, &offset);
+    DecodeArgs args = {.size = size, .flag = RTEST(rb_big)};
+    if (!decode_without_gvl(call_decode_r16, &args, rb_data, ret, offset))
         return Qnil;
     return ret;
 }
@@ -103,14 +337,21 @@ static VALUE rb_decode_r16(VALUE self, VALUE rb_data, VALUE rb_size, VALUE rb_bi
  * @param [String] rb_data binary to decode
  * @param [Integer] rb_size width * height
  * @param [Boolean] rb_big whether input data are big endian
- * @return [String] decoded rgb binary
+ * @param [String, nil] rb_dest string to write the result into, or nil to allocate a new one
+ * @param [Integer, nil] rb_offset byte offset in rb_dest to write the result at
+ * @return [String] decoded rgb binary (rb_dest if given)
  */
-static VALUE rb_decode_rgb565(VALUE self, VALUE rb_data, VALUE rb_size, VALUE rb_big) {
+static VALUE rb_decode_rgb565(int argc, VALUE *argv, VALUE self) {
+    VALUE rb_dest, rb_offset;
+    scan_output_args(argc, argv, 3, &rb_dest, &rb_offset);
+    VALUE rb_data = argv[0], rb_size = argv[1], rb_big = argv[2];
     long size = FIX2LONG(rb_size);
     if (!check_str_len(rb_data, size, 2))
         return Qnil;
-    VALUE ret = rb_alloc_rgb(size);
-    if (!decode_rgb565((uint16_t *)RSTRING_PTR(rb_data), size, RTEST(rb_big), (uint8_t *)RSTRING_PTR(ret)))
+    long offset;
+    VALUE ret = rb_alloc_rgb(rb_dest, rb_offset, size, &offset);
+    DecodeArgs args = {.size = size, .flag = RTEST(rb_big)};
+    if (!decode_without_gvl(call_decode_rgb565, &args, rb_data, ret, offset))
         return Qnil;
     return ret;
 }
@@ -122,14 +363,21 @@ static VALUE rb_decode_rgb565(VALUE self, VALUE rb_data, VALUE rb_size, VALUE rb
  * @param [String] rb_data binary to decode
  * @param [Integer] rb_size width * height
  * @param [Boolean] rb_big whether input data are big endian
- * @return [String] decoded rgb binary
+ * @param [String, nil] rb_dest string to write the result into, or nil to allocate a new one
+ * @param [Integer, nil] rb_offset byte offset in rb_dest to write the result at
+ * @return [String] decoded rgb binary (rb_dest if given)
  */
-static VALUE rb_decode_rhalf(VALUE self, VALUE rb_data, VALUE rb_size, VALUE rb_big) {
+static VALUE rb_decode_rhalf(int argc, VALUE *argv, VALUE self) {
+    VALUE rb_dest, rb_offset;
+    scan_output_args(argc, argv, 3, &rb_dest, &rb_offset);
+    VALUE rb_data = argv[0], rb_size = argv[1], rb_big = argv[2];
     long size = FIX2LONG(rb_size);
     if (!check_str_len(rb_data, size, 2))
         return Qnil;
-    VALUE ret = rb_alloc_rgb(size);
-    if (!decode_rhalf((uint16_t *)RSTRING_PTR(rb_data), size, RTEST(rb_big), (uint8_t *)RSTRING_PTR(ret)))
+    long offset;
+    VALUE ret = rb_alloc_rgb(rb_dest, rb_offset, size, &offset);
+    DecodeArgs args = {.size = size, .flag = RTEST(rb_big)};
+    if (!decode_without_gvl(call_decode_rhalf, &args, rb_data, ret, offset))
         return Qnil;
     return ret;
 }
@@ -141,14 +389,21 @@ static VALUE rb_decode_rhalf(VALUE self, VALUE rb_data, VALUE rb_size, VALUE rb_
  * @param [String] rb_data binary to decode
  * @param [Integer] rb_size width * height
  * @param [Boolean] rb_big whether input data are big endian
- * @return [String] decoded rgb binary
+ * @param [String, nil] rb_dest string to write the result into, or nil to allocate a new one
+ * @param [Integer, nil] rb_offset byte offset in rb_dest to write the result at
+ * @return [String] decoded rgb binary (rb_dest if given)
  */
-static VALUE rb_decode_rghalf(VALUE self, VALUE rb_data, VALUE rb_size, VALUE rb_big) {
+static VALUE rb_decode_rghalf(int argc, VALUE *argv, VALUE self) {
+    VALUE rb_dest, rb_offset;
+    scan_output_args(argc, argv, 3, &rb_dest, &rb_offset);
+    VALUE rb_data = argv[0], rb_size = argv[1], rb_big = argv[2];
     long size = FIX2LONG(rb_size);
     if (!check_str_len(rb_data, size, 4))
         return Qnil;
-    VALUE ret = rb_alloc_rgb(size);
-    if (!decode_rghalf((uint16_t *)RSTRING_PTR(rb_data), size, RTEST(rb_big), (uint8_t *)RSTRING_PTR(ret)))
+    long offset;
+    VALUE ret = rb_alloc_rgb(rb_dest, rb_offset, size, &offset);
+    DecodeArgs args = {.size = size, .flag = RTEST(rb_big)};
+    if (!decode_without_gvl(call_decode_rghalf, &args, rb_data, ret, offset))
         return Qnil;
     return ret;
 }
@@ -160,14 +415,288 @@ static VALUE rb_decode_rghalf(VALUE self, VALUE rb_data, VALUE rb_size, VALUE rb
  * @param [String] rb_data binary to decode
  * @param [Integer] rb_size width * height
  * @param [Boolean] rb_big whether input data are big endian
- * @return [String] decoded rgba binary
+ * @param [String, nil] rb_dest string to write the result into, or nil to allocate a new one
+ * @param [Integer, nil] rb_offset byte offset in rb_dest to write the result at
+ * @return [String] decoded rgba binary (rb_dest if given)
  */
-static VALUE rb_decode_rgbahalf(VALUE self, VALUE rb_data, VALUE rb_size, VALUE rb_big) {
+static VALUE rb_decode_rgbahalf(int argc, VALUE *argv, VALUE self) {
+    VALUE rb_dest, rb_offset;
+    scan_output_args(argc, argv, 3, &rb_dest, &rb_offset);
+    VALUE rb_data = argv[0], rb_size = argv[1], rb_big = argv[2];
     long size = FIX2LONG(rb_size);
     if (!check_str_len(rb_data, size, 8))
         return Qnil;
-    VALUE ret = rb_alloc_rgba(size);
-    if (!decode_rgbahalf((uint16_t *)RSTRING_PTR(rb_data), size, RTEST(rb_big), (uint8_t *)RSTRING_PTR(ret)))
+    long offset;
+    VALUE ret = rb_alloc_rgba(rb_dest, rb_offset, size, &offset);
+    DecodeArgs args = {.size = size, .flag = RTEST(rb_big)};
+    if (!decode_without_gvl(call_decode_rgbahalf, &args, rb_data, ret, offset))
+        return Qnil;
+    return ret;
+}
+
+/*
+ * Decode image from ARGB32 binary
+ * Returned image is flipped vertically
+ *
+ * @param [String] rb_data binary to decode
+ * @param [Integer] rb_w image width
+ * @param [Integer] rb_h image height
+ * @param [String, nil] rb_dest string to write the result into, or nil to allocate a new one
+ * @param [Integer, nil] rb_offset byte offset in rb_dest to write the result at
+ * @return [String] decoded rgba binary (rb_dest if given)
+ */
+static VALUE rb_decode_argb32(int argc, VALUE *argv, VALUE self) {
+    VALUE rb_dest, rb_offset;
+    scan_output_args(argc, argv, 3, &rb_dest, &rb_offset);
+    VALUE rb_data = argv[0], rb_w = argv[1], rb_h = argv[2];
+    long w = FIX2LONG(rb_w), h = FIX2LONG(rb_h);
+    if (!check_str_len(rb_data, w * h, 4))
+        return Qnil;
+    long offset;
+    VALUE ret = rb_alloc_rgba(rb_dest, rb_offset, w * h, &offset);
+    DecodeArgs args = {.w = w, .h = h};
+    if (!decode_without_gvl(call_decode_argb32, &args, rb_data, ret, offset))
+        return Qnil;
+    return ret;
+}
+
+/*
+ * Decode image from BGRA32 binary
+ * Returned image is flipped vertically
+ *
+ * @param [String] rb_data binary to decode
+ * @param [Integer] rb_w image width
+ * @param [Integer] rb_h image height
+ * @param [String, nil] rb_dest string to write the result into, or nil to allocate a new one
+ * @param [Integer, nil] rb_offset byte offset in rb_dest to write the result at
+ * @return [String] decoded rgba binary (rb_dest if given)
+ */
+static VALUE rb_decode_bgra32(int argc, VALUE *argv, VALUE self) {
+    VALUE rb_dest, rb_offset;
+    scan_output_args(argc, argv, 3, &rb_dest, &rb_offset);
+    VALUE rb_data = argv[0], rb_w = argv[1], rb_h = argv[2];
+    long w = FIX2LONG(rb_w), h = FIX2LONG(rb_h);
+    if (!check_str_len(rb_data, w * h, 4))
+        return Qnil;
+    long offset;
+    VALUE ret = rb_alloc_rgba(rb_dest, rb_offset, w * h, &offset);
+    DecodeArgs args = {.w = w, .h = h};
+    if (!decode_without_gvl(call_decode_bgra32, &args, rb_data, ret, offset))
+        return Qnil;
+    return ret;
+}
+
+/*
+ * Decode image from ARGB4444 binary
+ * Returned image is flipped vertically
+ *
+ * @param [String] rb_data binary to decode
+ * @param [Integer] rb_w image width
+ * @param [Integer] rb_h image height
+ * @param [Boolean] rb_big whether input data are big endian
+ * @param [String, nil] rb_dest string to write the result into, or nil to allocate a new one
+ * @param [Integer, nil] rb_offset byte offset in rb_dest to write the result at
+ * @return [String] decoded rgba binary (rb_dest if given)
+ */
+static VALUE rb_decode_argb4444(int argc, VALUE *argv, VALUE self) {
+    VALUE rb_dest, rb_offset;
+    scan_output_args(argc, argv, 4, &rb_dest, &rb_offset);
+    VALUE rb_data = argv[0], rb_w = argv[1], rb_h = argv[2], rb_big = argv[3];
+    long w = FIX2LONG(rb_w), h = FIX2LONG(rb_h);
+    if (!check_str_len(rb_data, w * h, 2))
+        return Qnil;
+    long offset;
+    VALUE ret = rb_alloc_rgba(rb_dest, rb_offset, w * h, &offset);
+    DecodeArgs args = {.w = w, .h = h, .flag = RTEST(rb_big)};
+    if (!decode_without_gvl(call_decode_argb4444, &args, rb_data, ret, offset))
+        return Qnil;
+    return ret;
+}
+
+/*
+ * Decode image from RGBA4444 binary
+ * Returned image is flipped vertically
+ *
+ * @param [String] rb_data binary to decode
+ * @param [Integer] rb_w image width
+ * @param [Integer] rb_h image height
+ * @param [Boolean] rb_big whether input data are big endian
+ * @param [String, nil] rb_dest string to write the result into, or nil to allocate a new one
+ * @param [Integer, nil] rb_offset byte offset in rb_dest to write the result at
+ * @return [String] decoded rgba binary (rb_dest if given)
+ */
+static VALUE rb_decode_rgba4444(int argc, VALUE *argv, VALUE self) {
+    VALUE rb_dest, rb_offset;
+    scan_output_args(argc, argv, 4, &rb_dest, &rb_offset);
+    VALUE rb_data = argv[0], rb_w = argv[1], rb_h = argv[2], rb_big = argv[3];
+    long w = FIX2LONG(rb_w), h = FIX2LONG(rb_h);
+    if (!check_str_len(rb_data, w * h, 2))
+        return Qnil;
+    long offset;
+    VALUE ret = rb_alloc_rgba(rb_dest, rb_offset, w * h, &offset);
+    DecodeArgs args = {.w = w, .h = h, .flag = RTEST(rb_big)};
+    if (!decode_without_gvl(call_decode_rgba4444, &args, rb_data, ret, offset))
+        return Qnil;
+    return ret;
+}
+
+/*
+ * Decode image from RG16 binary
+ * Returned image is flipped vertically
+ *
+ * @param [String] rb_data binary to decode
+ * @param [Integer] rb_w image width
+ * @param [Integer] rb_h image height
+ * @param [String, nil] rb_dest string to write the result into, or nil to allocate a new one
+ * @param [Integer, nil] rb_offset byte offset in rb_dest to write the result at
+ * @return [String] decoded rgb binary (rb_dest if given)
+ */
+static VALUE rb_decode_rg16(int argc, VALUE *argv, VALUE self) {
+    VALUE rb_dest, rb_offset;
+    scan_output_args(argc, argv, 3, &rb_dest, &rb_offset);
+    VALUE rb_data = argv[0], rb_w = argv[1], rb_h = argv[2];
+    long w = FIX2LONG(rb_w), h = FIX2LONG(rb_h);
+    if (!check_str_len(rb_data, w * h, 2))
+        return Qnil;
+    long offset;
+    VALUE ret = rb_alloc_rgb(rb_dest, rb_offset, w * h, &offset);
+    DecodeArgs args = {.w = w, .h = h};
+    if (!decode_without_gvl(call_decode_rg16, &args, rb_data, ret, offset))
+        return Qnil;
+    return ret;
+}
+
+/*
+ * Decode image from RFloat binary
+ * Returned image is flipped vertically
+ *
+ * @param [String] rb_data binary to decode
+ * @param [Integer] rb_w image width
+ * @param [Integer] rb_h image height
+ * @param [Boolean] rb_big whether input data are big endian
+ * @param [String, nil] rb_dest string to write the result into, or nil to allocate a new one
+ * @param [Integer, nil] rb_offset byte offset in rb_dest to write the result at
+ * @return [String] decoded rgb binary (rb_dest if given)
+ */
+static VALUE rb_decode_rfloat(int argc, VALUE *argv, VALUE self) {
+    VALUE rb_dest, rb_offset;
+    scan_output_args(argc, argv, 4, &rb_dest, &rb_offset);
+    VALUE rb_data = argv[0], rb_w = argv[1], rb_h = argv[2], rb_big = argv[3];
+    long w = FIX2LONG(rb_w), h = FIX2LONG(rb_h);
+    if (!check_str_len(rb_data, w * h, 4))
+        return Qnil;
+    long offset;
+    VALUE ret = rb_alloc_rgb(rb_dest, rb_offset, w * h, &offset);
+    DecodeArgs args = {.w = w, .h = h, .flag = RTEST(rb_big)};
+    if (!decode_without_gvl(call_decode_rfloat, &args, rb_data, ret, offset))
+        return Qnil;
+    return ret;
+}
+
+/*
+ * Decode image from RGFloat binary
+ * Returned image is flipped vertically
+ *
+ * @param [String] rb_data binary to decode
+ * @param [Integer] rb_w image width
+ * @param [Integer] rb_h image height
+ * @param [Boolean] rb_big whether input data are big endian
+ * @param [String, nil] rb_dest string to write the result into, or nil to allocate a new one
+ * @param [Integer, nil] rb_offset byte offset in rb_dest to write the result at
+ * @return [String] decoded rgb binary (rb_dest if given)
+ */
+static VALUE rb_decode_rgfloat(int argc, VALUE *argv, VALUE self) {
+    VALUE rb_dest, rb_offset;
+    scan_output_args(argc, argv, 4, &rb_dest, &rb_offset);
+    VALUE rb_data = argv[0], rb_w = argv[1], rb_h = argv[2], rb_big = argv[3];
+    long w = FIX2LONG(rb_w), h = FIX2LONG(rb_h);
+    if (!check_str_len(rb_data, w * h, 8))
+        return Qnil;
+    long offset;
+    VALUE ret = rb_alloc_rgb(rb_dest, rb_offset, w * h, &offset);
+    DecodeArgs args = {.w = w, .h = h, .flag = RTEST(rb_big)};
+    if (!decode_without_gvl(call_decode_rgfloat, &args, rb_data, ret, offset))
+        return Qnil;
+    return ret;
+}
+
+/*
+ * Decode image from RGBAFloat binary
+ * Returned image is flipped vertically
+ *
+ * @param [String] rb_data binary to decode
+ * @param [Integer] rb_w image width
+ * @param [Integer] rb_h image height
+ * @param [Boolean] rb_big whether input data are big endian
+ * @param [String, nil] rb_dest string to write the result into, or nil to allocate a new one
+ * @param [Integer, nil] rb_offset byte offset in rb_dest to write the result at
+ * @return [String] decoded rgba binary (rb_dest if given)
+ */
+static VALUE rb_decode_rgbafloat(int argc, VALUE *argv, VALUE self) {
+    VALUE rb_dest, rb_offset;
+    scan_output_args(argc, argv, 4, &rb_dest, &rb_offset);
+    VALUE rb_data = argv[0], rb_w = argv[1], rb_h = argv[2], rb_big = argv[3];
+    long w = FIX2LONG(rb_w), h = FIX2LONG(rb_h);
+    if (!check_str_len(rb_data, w * h, 16))
+        return Qnil;
+    long offset;
+    VALUE ret = rb_alloc_rgba(rb_dest, rb_offset, w * h, &offset);
+    DecodeArgs args = {.w = w, .h = h, .flag = RTEST(rb_big)};
+    if (!decode_without_gvl(call_decode_rgbafloat, &args, rb_data, ret, offset))
+        return Qnil;
+    return ret;
+}
+
+/*
+ * Decode image from RGB9e5Float binary
+ * Returned image is flipped vertically
+ *
+ * @param [String] rb_data binary to decode
+ * @param [Integer] rb_w image width
+ * @param [Integer] rb_h image height
+ * @param [Boolean] rb_big whether input data are big endian
+ * @param [String, nil] rb_dest string to write the result into, or nil to allocate a new one
+ * @param [Integer, nil] rb_offset byte offset in rb_dest to write the result at
+ * @return [String] decoded rgb binary (rb_dest if given)
+ */
+static VALUE rb_decode_rgb9e5float(int argc, VALUE *argv, VALUE self) {
+    VALUE rb_dest, rb_offset;
+    scan_output_args(argc, argv, 4, &rb_dest, &rb_offset);
+    VALUE rb_data = argv[0], rb_w = argv[1], rb_h = argv[2], rb_big = argv[3];
+    long w = FIX2LONG(rb_w), h = FIX2LONG(rb_h);
+    if (!check_str_len(rb_data, w * h, 4))
+        return Qnil;
+    long offset;
+    VALUE ret = rb_alloc_rgb(rb_dest, rb_offset, w * h, &offset);
+    DecodeArgs args = {.w = w, .h = h, .flag = RTEST(rb_big)};
+    if (!decode_without_gvl(call_decode_rgb9e5float, &args, rb_data, ret, offset))
+        return Qnil;
+    return ret;
+}
+
+/*
+ * Flip raw pixels vertically
+ *
+ * @param [String] rb_data pixels to flip
+ * @param [Integer] rb_w image width
+ * @param [Integer] rb_h image height
+ * @param [Integer] rb_bpp bytes per pixel
+ * @param [String, nil] rb_dest string to write the result into, or nil to allocate a new one
+ * @param [Integer, nil] rb_offset byte offset in rb_dest to write the result at
+ * @return [String] flipped binary (rb_dest if given)
+ */
+static VALUE rb_flip_image(int argc, VALUE *argv, VALUE self) {
+    VALUE rb_dest, rb_offset;
+    scan_output_args(argc, argv, 4, &rb_dest, &rb_offset);
+    VALUE rb_data = argv[0], rb_w = argv[1], rb_h = argv[2], rb_bpp = argv[3];
+    long w = FIX2LONG(rb_w), h = FIX2LONG(rb_h);
+    int bpp = FIX2INT(rb_bpp);
+    if (!check_str_len(rb_data, w * h, bpp))
+        return Qnil;
+    long offset;
+    VALUE ret = rb_alloc_output(rb_dest, rb_offset, w * h * bpp, &offset);
+    DecodeArgs args = {.w = w, .h = h, .bpp = bpp};
+    if (!decode_without_gvl(call_flip_image, &args, rb_data, ret, offset))
         return Qnil;
     return ret;
 }
@@ -178,14 +707,21 @@ static VALUE rb_decode_rgbahalf(VALUE self, VALUE rb_data, VALUE rb_size, VALUE
  * @param [String] rb_data binary to decode
  * @param [Integer] rb_w image width
  * @param [Integer] rb_h image height
- * @return [String] decoded rgba binary
+ * @param [String, nil] rb_dest string to write the result into, or nil to allocate a new one
+ * @param [Integer, nil] rb_offset byte offset in rb_dest to write the result at
+ * @return [String] decoded rgba binary (rb_dest if given)
  */
-static VALUE rb_decode_etc1(VALUE self, VALUE rb_data, VALUE rb_w, VALUE rb_h) {
+static VALUE rb_decode_etc1(int argc, VALUE *argv, VALUE self) {
+    VALUE rb_dest, rb_offset;
+    scan_output_args(argc, argv, 3, &rb_dest, &rb_offset);
+    VALUE rb_data = argv[0], rb_w = argv[1], rb_h = argv[2];
     long w = FIX2LONG(rb_w), h = FIX2LONG(rb_h);
     if (!check_str_len_block(rb_data, w, h, 4, 4, 8))
         return Qnil;
-    VALUE ret = rb_alloc_rgba(w * h);
-    if (!decode_etc1((uint8_t *)RSTRING_PTR(rb_data), w, h, (uint32_t *)RSTRING_PTR(ret)))
+    long offset;
+    VALUE ret = rb_alloc_rgba(rb_dest, rb_offset, w * h, &offset);
+    DecodeArgs args = {.w = w, .h = h};
+    if (!decode_without_gvl(call_decode_etc1, &args, rb_data, ret, offset))
         return Qnil;
     return ret;
 }
@@ -196,14 +732,21 @@ static VALUE rb_decode_etc1(VALUE self, VALUE rb_data, VALUE rb_w, VALUE rb_h) {
  * @param [String] rb_data binary to decode
  * @param [Integer] rb_w image width
  * @param [Integer] rb_h image height
- * @return [String] decoded rgba binary
+ * @param [String, nil] rb_dest string to write the result into, or nil to allocate a new one
+ * @param [Integer, nil] rb_offset byte offset in rb_dest to write the result at
+ * @return [String] decoded rgba binary (rb_dest if given)
  */
-static VALUE rb_decode_etc2(VALUE self, VALUE rb_data, VALUE rb_w, VALUE rb_h) {
+static VALUE rb_decode_etc2(int argc, VALUE *argv, VALUE self) {
+    VALUE rb_dest, rb_offset;
+    scan_output_args(argc, argv, 3, &rb_dest, &rb_offset);
+    VALUE rb_data = argv[0], rb_w = argv[1], rb_h = argv[2];
     long w = FIX2LONG(rb_w), h = FIX2LONG(rb_h);
     if (!check_str_len_block(rb_data, w, h, 4, 4, 8))
         return Qnil;
-    VALUE ret = rb_alloc_rgba(w * h);
-    if (!decode_etc2((uint8_t *)RSTRING_PTR(rb_data), w, h, (uint32_t *)RSTRING_PTR(ret)))
+    long offset;
+    VALUE ret = rb_alloc_rgba(rb_dest, rb_offset, w * h, &offset);
+    DecodeArgs args = {.w = w, .h = h};
+    if (!decode_without_gvl(call_decode_etc2, &args, rb_data, ret, offset))
         return Qnil;
     return ret;
 }
@@ -214,14 +757,21 @@ static VALUE rb_decode_etc2(VALUE self, VALUE rb_data, VALUE rb_w, VALUE rb_h) {
  * @param [String] rb_data binary to decode
  * @param [Integer] rb_w image width
  * @param [Integer] rb_h image height
- * @return [String] decoded rgba binary
+ * @param [String, nil] rb_dest string to write the result into, or nil to allocate a new one
+ * @param [Integer, nil] rb_offset byte offset in rb_dest to write the result at
+ * @return [String] decoded rgba binary (rb_dest if given)
  */
-static VALUE rb_decode_etc2a1(VALUE self, VALUE rb_data, VALUE rb_w, VALUE rb_h) {
+static VALUE rb_decode_etc2a1(int argc, VALUE *argv, VALUE self) {
+    VALUE rb_dest, rb_offset;
+    scan_output_args(argc, argv, 3, &rb_dest, &rb_offset);
+    VALUE rb_data = argv[0], rb_w = argv[1], rb_h = argv[2];
     long w = FIX2LONG(rb_w), h = FIX2LONG(rb_h);
     if (!check_str_len_block(rb_data, w, h, 4, 4, 8))
         return Qnil;
-    VALUE ret = rb_alloc_rgba(w * h);
-    if (!decode_etc2a1((uint8_t *)RSTRING_PTR(rb_data), w, h, (uint32_t *)RSTRING_PTR(ret)))
+    long offset;
+    VALUE ret = rb_alloc_rgba(rb_dest, rb_offset, w * h, &offset);
+    DecodeArgs args = {.w = w, .h = h};
+    if (!decode_without_gvl(call_decode_etc2a1, &args, rb_data, ret, offset))
         return Qnil;
     return ret;
 }
@@ -232,14 +782,21 @@ static VALUE rb_decode_etc2a1(VALUE self, VALUE rb_data, VALUE rb_w, VALUE rb_h)
  * @param [String] rb_data binary to decode
  * @param [Integer] rb_w image width
  * @param [Integer] rb_h image height
- * @return [String] decoded rgba binary
+ * @param [String, nil] rb_dest string to write the result into, or nil to allocate a new one
+ * @param [Integer, nil] rb_offset byte offset in rb_dest to write the result at
+ * @return [String] decoded rgba binary (rb_dest if given)
  */
-static VALUE rb_decode_etc2a8(VALUE self, VALUE rb_data, VALUE rb_w, VALUE rb_h) {
+static VALUE rb_decode_etc2a8(int argc, VALUE *argv, VALUE self) {
+    VALUE rb_dest, rb_offset;
+    scan_output_args(argc, argv, 3, &rb_dest, &rb_offset);
+    VALUE rb_data = argv[0], rb_w = argv[1], rb_h = argv[2];
     long w = FIX2LONG(rb_w), h = FIX2LONG(rb_h);
     if (!check_str_len_block(rb_data, w, h, 4, 4, 16))
         return Qnil;
-    VALUE ret = rb_alloc_rgba(w * h);
-    if (!decode_etc2a8((uint8_t *)RSTRING_PTR(rb_data), w, h, (uint32_t *)RSTRING_PTR(ret)))
+    long offset;
+    VALUE ret = rb_alloc_rgba(rb_dest, rb_offset, w * h, &offset);
+    DecodeArgs args = {.w = w, .h = h};
+    if (!decode_without_gvl(call_decode_etc2a8, &args, rb_data, ret, offset))
         return Qnil;
     return ret;
 }
@@ -250,14 +807,21 @@ static VALUE rb_decode_etc2a8(VALUE self, VALUE rb_data, VALUE rb_w, VALUE rb_h)
  * @param [String] rb_data binary to decode
  * @param [Integer] rb_w image width
  * @param [Integer] rb_h image height
- * @return [String] decoded rgba binary
+ * @param [String, nil] rb_dest string to write the result into, or nil to allocate a new one
+ * @param [Integer, nil] rb_offset byte offset in rb_dest to write the result at
+ * @return [String] decoded rgba binary (rb_dest if given)
  */
-static VALUE rb_decode_eacr(VALUE self, VALUE rb_data, VALUE rb_w, VALUE rb_h) {
+static VALUE rb_decode_eacr(int argc, VALUE *argv, VALUE self) {
+    VALUE rb_dest, rb_offset;
+    scan_output_args(argc, argv, 3, &rb_dest, &rb_offset);
+    VALUE rb_data = argv[0], rb_w = argv[1], rb_h = argv[2];
     long w = FIX2LONG(rb_w), h = FIX2LONG(rb_h);
     if (!check_str_len_block(rb_data, w, h, 4, 4, 8))
         return Qnil;
-    VALUE ret = rb_alloc_rgba(w * h);
-    if (!decode_eacr((uint8_t *)RSTRING_PTR(rb_data), w, h, (uint32_t *)RSTRING_PTR(ret)))
+    long offset;
+    VALUE ret = rb_alloc_rgba(rb_dest, rb_offset, w * h, &offset);
+    DecodeArgs args = {.w = w, .h = h};
+    if (!decode_without_gvl(call_decode_eacr, &args, rb_data, ret, offset))
         return Qnil;
     return ret;
 }
@@ -268,14 +832,21 @@ static VALUE rb_decode_eacr(VALUE self, VALUE rb_data, VALUE rb_w, VALUE rb_h) {
  * @param [String] rb_data binary to decode
  * @param [Integer] rb_w image width
  * @param [Integer] rb_h image height
- * @return [String] decoded rgba binary
+ * @param [String, nil] rb_dest string to write the result into, or nil to allocate a new one
+ * @param [Integer, nil] rb_offset byte offset in rb_dest to write the result at
+ * @return [String] decoded rgba binary (rb_dest if given)
  */
-static VALUE rb_decode_eacsr(VALUE self, VALUE rb_data, VALUE rb_w, VALUE rb_h) {
+static VALUE rb_decode_eacsr(int argc, VALUE *argv, VALUE self) {
+    VALUE rb_dest, rb_offset;
+    scan_output_args(argc, argv, 3, &rb_dest, &rb_offset);
+    VALUE rb_data = argv[0], rb_w = argv[1], rb_h = argv[2];
     long w = FIX2LONG(rb_w), h = FIX2LONG(rb_h);
     if (!check_str_len_block(rb_data, w, h, 4, 4, 8))
         return Qnil;
-    VALUE ret = rb_alloc_rgba(w * h);
-    if (!decode_eacr_signed((uint8_t *)RSTRING_PTR(rb_data), w, h, (uint32_t *)RSTRING_PTR(ret)))
+    long offset;
+    VALUE ret = rb_alloc_rgba(rb_dest, rb_offset, w * h, &offset);
+    DecodeArgs args = {.w = w, .h = h};
+    if (!decode_without_gvl(call_decode_eacr_signed, &args, rb_data, ret, offset))
         return Qnil;
     return ret;
 }
@@ -286,14 +857,21 @@ static VALUE rb_decode_eacsr(VALUE self, VALUE rb_data, VALUE rb_w, VALUE rb_h)
  * @param [String] rb_data binary to decode
  * @param [Integer] rb_w image width
  * @param [Integer] rb_h image height
- * @return [String] decoded rgba binary
+ * @param [String, nil] rb_dest string to write the result into, or nil to allocate a new one
+ * @param [Integer, nil] rb_offset byte offset in rb_dest to write the result at
+ * @return [String] decoded rgba binary (rb_dest if given)
  */
-static VALUE rb_decode_eacrg(VALUE self, VALUE rb_data, VALUE rb_w, VALUE rb_h) {
+static VALUE rb_decode_eacrg(int argc, VALUE *argv, VALUE self) {
+    VALUE rb_dest, rb_offset;
+    scan_output_args(argc, argv, 3, &rb_dest, &rb_offset);
+    VALUE rb_data = argv[0], rb_w = argv[1], rb_h = argv[2];
     long w = FIX2LONG(rb_w), h = FIX2LONG(rb_h);
     if (!check_str_len_block(rb_data, w, h, 4, 4, 16))
         return Qnil;
-    VALUE ret = rb_alloc_rgba(w * h);
-    if (!decode_eacrg((uint8_t *)RSTRING_PTR(rb_data), w, h, (uint32_t *)RSTRING_PTR(ret)))
+    long offset;
+    VALUE ret = rb_alloc_rgba(rb_dest, rb_offset, w * h, &offset);
+    DecodeArgs args = {.w = w, .h = h};
+    if (!decode_without_gvl(call_decode_eacrg, &args, rb_data, ret, offset))
         return Qnil;
     return ret;
 }
@@ -304,14 +882,21 @@ static VALUE rb_decode_eacrg(VALUE self, VALUE rb_data, VALUE rb_w, VALUE rb_h)
  * @param [String] rb_data binary to decode
  * @param [Integer] rb_w image width
  * @param [Integer] rb_h image height
- * @return [String] decoded rgba binary
+ * @param [String, nil] rb_dest string to write the result into, or nil to allocate a new one
+ * @param [Integer, nil] rb_offset byte offset in rb_dest to write the result at
+ * @return [String] decoded rgba binary (rb_dest if given)
  */
-static VALUE rb_decode_eacsrg(VALUE self, VALUE rb_data, VALUE rb_w, VALUE rb_h) {
+static VALUE rb_decode_eacsrg(int argc, VALUE *argv, VALUE self) {
+    VALUE rb_dest, rb_offset;
+    scan_output_args(argc, argv, 3, &rb_dest, &rb_offset);
+    VALUE rb_data = argv[0], rb_w = argv[1], rb_h = argv[2];
     long w = FIX2LONG(rb_w), h = FIX2LONG(rb_h);
     if (!check_str_len_block(rb_data, w, h, 4, 4, 16))
         return Qnil;
-    VALUE ret = rb_alloc_rgba(w * h);
-    if (!decode_eacrg_signed((uint8_t *)RSTRING_PTR(rb_data), w, h, (uint32_t *)RSTRING_PTR(ret)))
+    long offset;
+    VALUE ret = rb_alloc_rgba(rb_dest, rb_offset, w * h, &offset);
+    DecodeArgs args = {.w = w, .h = h};
+    if (!decode_without_gvl(call_decode_eacrg_signed, &args, rb_data, ret, offset))
         return Qnil;
     return ret;
 }
@@ -324,17 +909,24 @@ static VALUE rb_decode_eacsrg(VALUE self, VALUE rb_data, VALUE rb_w, VALUE rb_h)
  * @param [Integer] rb_h image height
  * @param [Integer] rb_bw block width
  * @param [Integer] rb_bh block height
- * @return [String] decoded rgba binary
+ * @param [String, nil] rb_dest string to write the result into, or nil to allocate a new one
+ * @param [Integer, nil] rb_offset byte offset in rb_dest to write the result at
+ * @return [String] decoded rgba binary (rb_dest if given)
  */
-static VALUE rb_decode_astc(VALUE self, VALUE rb_data, VALUE rb_w, VALUE rb_h, VALUE rb_bw, VALUE rb_bh) {
+static VALUE rb_decode_astc(int argc, VALUE *argv, VALUE self) {
+    VALUE rb_dest, rb_offset;
+    scan_output_args(argc, argv, 5, &rb_dest, &rb_offset);
+    VALUE rb_data = argv[0], rb_w = argv[1], rb_h = argv[2], rb_bw = argv[3], rb_bh = argv[4];
     long w = FIX2LONG(rb_w);
     long h = FIX2LONG(rb_h);
     int bw = FIX2INT(rb_bw);
     int bh = FIX2INT(rb_bh);
     if (!check_str_len_block(rb_data, w, h, bw, bh, 16))
         return Qnil;
-    VALUE ret = rb_alloc_rgba(w * h);
-    DECODE_CHECK(decode_astc((uint8_t *)RSTRING_PTR(rb_data), w, h, bw, bh, (uint32_t *)RSTRING_PTR(ret)));
+    long offset;
+    VALUE ret = rb_alloc_rgba(rb_dest, rb_offset, w * h, &offset);
+    DecodeArgs args = {.w = w, .h = h, .bw = bw, .bh = bh};
+    DECODE_CHECK(decode_without_gvl(call_decode_astc, &args, rb_data, ret, offset));
     return ret;
 }
 
@@ -344,15 +936,22 @@ static VALUE rb_decode_astc(VALUE self, VALUE rb_data, VALUE rb_w, VALUE rb_h, V
  * @param [String] rb_data binary to decode
  * @param [Integer] rb_w image width
  * @param [Integer] rb_h image height
- * @return [String] decoded rgba binary
+ * @param [String, nil] rb_dest string to write the result into, or nil to allocate a new one
+ * @param [Integer, nil] rb_offset byte offset in rb_dest to write the result at
+ * @return [String] decoded rgba binary (rb_dest if given)
  */
-static VALUE rb_decode_dxt1(VALUE self, VALUE rb_data, VALUE rb_w, VALUE rb_h) {
+static VALUE rb_decode_dxt1(int argc, VALUE *argv, VALUE self) {
+    VALUE rb_dest, rb_offset;
+    scan_output_args(argc, argv, 3, &rb_dest, &rb_offset);
+    VALUE rb_data = argv[0], rb_w = argv[1], rb_h = argv[2];
     long w = FIX2LONG(rb_w);
     long h = FIX2LONG(rb_h);
     if (!check_str_len_block(rb_data, w, h, 4, 4, 8))
         return Qnil;
-    VALUE ret = rb_alloc_rgba(w * h);
-    DECODE_CHECK(decode_dxt1((uint8_t *)RSTRING_PTR(rb_data), w, h, (uint32_t *)RSTRING_PTR(ret)));
+    long offset;
+    VALUE ret = rb_alloc_rgba(rb_dest, rb_offset, w * h, &offset);
+    DecodeArgs args = {.w = w, .h = h};
+    DECODE_CHECK(decode_without_gvl(call_decode_dxt1, &args, rb_data, ret, offset));
     return ret;
 }
 
@@ -362,15 +961,122 @@ static VALUE rb_decode_dxt1(VALUE self, VALUE rb_data, VALUE rb_w, VALUE rb_h) {
  * @param [String] rb_data binary to decode
  * @param [Integer] rb_w image width
  * @param [Integer] rb_h image height
- * @return [String] decoded rgba binary
+ * @param [String, nil] rb_dest string to write the result into, or nil to allocate a new one
+ * @param [Integer, nil] rb_offset byte offset in rb_dest to write the result at
+ * @return [String] decoded rgba binary (rb_dest if given)
  */
-static VALUE rb_decode_dxt5(VALUE self, VALUE rb_data, VALUE rb_w, VALUE rb_h) {
+static VALUE rb_decode_dxt5(int argc, VALUE *argv, VALUE self) {
+    VALUE rb_dest, rb_offset;
+    scan_output_args(argc, argv, 3, &rb_dest, &rb_offset);
+    VALUE rb_data = argv[0], rb_w = argv[1], rb_h = argv[2];
     long w = FIX2LONG(rb_w);
     long h = FIX2LONG(rb_h);
     if (!check_str_len_block(rb_data, w, h, 4, 4, 16))
         return Qnil;
-    VALUE ret = rb_alloc_rgba(w * h);
-    DECODE_CHECK(decode_dxt5((uint8_t *)RSTRING_PTR(rb_data), w, h, (uint32_t *)RSTRING_PTR(ret)));
+    long offset;
+    VALUE ret = rb_alloc_rgba(rb_dest, rb_offset, w * h, &offset);
+    DecodeArgs args = {.w = w, .h = h};
+    DECODE_CHECK(decode_without_gvl(call_decode_dxt5, &args, rb_data, ret, offset));
+    return ret;
+}
+
+/*
+ * Decode image from BC4 compressed binary
+ *
+ * @param [String] rb_data binary to decode
+ * @param [Integer] rb_w image width
+ * @param [Integer] rb_h image height
+ * @param [String, nil] rb_dest string to write the result into, or nil to allocate a new one
+ * @param [Integer, nil] rb_offset byte offset in rb_dest to write the result at
+ * @return [String] decoded rgba binary (rb_dest if given)
+ */
+static VALUE rb_decode_bc4(int argc, VALUE *argv, VALUE self) {
+    VALUE rb_dest, rb_offset;
+    scan_output_args(argc, argv, 3, &rb_dest, &rb_offset);
+    VALUE rb_data = argv[0], rb_w = argv[1], rb_h = argv[2];
+    long w = FIX2LONG(rb_w);
+    long h = FIX2LONG(rb_h);
+    if (!check_str_len_block(rb_data, w, h, 4, 4, 8))
+        return Qnil;
+    long offset;
+    VALUE ret = rb_alloc_rgba(rb_dest, rb_offset, w * h, &offset);
+    DecodeArgs args = {.w = w, .h = h};
+    DECODE_CHECK(decode_without_gvl(call_decode_bc4, &args, rb_data, ret, offset));
+    return ret;
+}
+
+/*
+ * Decode image from BC5 compressed binary
+ *
+ * @param [String] rb_data binary to decode
+ * @param [Integer] rb_w image width
+ * @param [Integer] rb_h image height
+ * @param [String, nil] rb_dest string to write the result into, or nil to allocate a new one
+ * @param [Integer, nil] rb_offset byte offset in rb_dest to write the result at
+ * @return [String] decoded rgba binary (rb_dest if given)
+ */
+static VALUE rb_decode_bc5(int argc, VALUE *argv, VALUE self) {
+    VALUE rb_dest, rb_offset;
+    scan_output_args(argc, argv, 3, &rb_dest, &rb_offset);
+    VALUE rb_data = argv[0], rb_w = argv[1], rb_h = argv[2];
+    long w = FIX2LONG(rb_w);
+    long h = FIX2LONG(rb_h);
+    if (!check_str_len_block(rb_data, w, h, 4, 4, 16))
+        return Qnil;
+    long offset;
+    VALUE ret = rb_alloc_rgba(rb_dest, rb_offset, w * h, &offset);
+    DecodeArgs args = {.w = w, .h = h};
+    DECODE_CHECK(decode_without_gvl(call_decode_bc5, &args, rb_data, ret, offset));
+    return ret;
+}
+
+/*
+ * Decode image from BC6H (unsigned) compressed binary
+ *
+ * @param [String] rb_data binary to decode
+ * @param [Integer] rb_w image width
+ * @param [Integer] rb_h image height
+ * @param [String, nil] rb_dest string to write the result into, or nil to allocate a new one
+ * @param [Integer, nil] rb_offset byte offset in rb_dest to write the result at
+ * @return [String] decoded rgba binary (rb_dest if given)
+ */
+static VALUE rb_decode_bc6h(int argc, VALUE *argv, VALUE self) {
+    VALUE rb_dest, rb_offset;
+    scan_output_args(argc, argv, 3, &rb_dest, &rb_offset);
+    VALUE rb_data = argv[0], rb_w = argv[1], rb_h = argv[2];
+    long w = FIX2LONG(rb_w);
+    long h = FIX2LONG(rb_h);
+    if (!check_str_len_block(rb_data, w, h, 4, 4, 16))
+        return Qnil;
+    long offset;
+    VALUE ret = rb_alloc_rgba(rb_dest, rb_offset, w * h, &offset);
+    DecodeArgs args = {.w = w, .h = h};
+    DECODE_CHECK(decode_without_gvl(call_decode_bc6h, &args, rb_data, ret, offset));
+    return ret;
+}
+
+/*
+ * Decode image from BC7 compressed binary
+ *
+ * @param [String] rb_data binary to decode
+ * @param [Integer] rb_w image width
+ * @param [Integer] rb_h image height
+ * @param [String, nil] rb_dest string to write the result into, or nil to allocate a new one
+ * @param [Integer, nil] rb_offset byte offset in rb_dest to write the result at
+ * @return [String] decoded rgba binary (rb_dest if given)
+ */
+static VALUE rb_decode_bc7(int argc, VALUE *argv, VALUE self) {
+    VALUE rb_dest, rb_offset;
+    scan_output_args(argc, argv, 3, &rb_dest, &rb_offset);
+    VALUE rb_data = argv[0], rb_w = argv[1], rb_h = argv[2];
+    long w = FIX2LONG(rb_w);
+    long h = FIX2LONG(rb_h);
+    if (!check_str_len_block(rb_data, w, h, 4, 4, 16))
+        return Qnil;
+    long offset;
+    VALUE ret = rb_alloc_rgba(rb_dest, rb_offset, w * h, &offset);
+    DecodeArgs args = {.w = w, .h = h};
+    DECODE_CHECK(decode_without_gvl(call_decode_bc7, &args, rb_data, ret, offset));
     return ret;
 }
 
@@ -381,39 +1087,217 @@ static VALUE rb_decode_dxt5(VALUE self, VALUE rb_data, VALUE rb_w, VALUE rb_h) {
  * @param [Integer] rb_w image width
  * @param [Integer] rb_h image height
  * @param [Boolean] rb_is2bpp whether 2bpp or not (4bpp)
- * @return [String] decoded rgba binary
+ * @param [String, nil] rb_dest string to write the result into, or nil to allocate a new one
+ * @param [Integer, nil] rb_offset byte offset in rb_dest to write the result at
+ * @return [String] decoded rgba binary (rb_dest if given)
  */
-static VALUE rb_decode_pvrtc1(VALUE self, VALUE rb_data, VALUE rb_w, VALUE rb_h, VALUE rb_is2bpp) {
+static VALUE rb_decode_pvrtc1(int argc, VALUE *argv, VALUE self) {
+    VALUE rb_dest, rb_offset;
+    scan_output_args(argc, argv, 4, &rb_dest, &rb_offset);
+    VALUE rb_data = argv[0], rb_w = argv[1], rb_h = argv[2], rb_is2bpp = argv[3];
     int is2bpp = RTEST(rb_is2bpp);
     long w = FIX2LONG(rb_w);
     long h = FIX2LONG(rb_h);
     if (!check_str_len_block(rb_data, w, h, is2bpp ? 8 : 4, 4, 8))
         return Qnil;
-    VALUE ret = rb_alloc_rgba(w * h);
-    DECODE_CHECK(decode_pvrtc((uint8_t *)RSTRING_PTR(rb_data), w, h, (uint32_t *)RSTRING_PTR(ret), is2bpp));
+    long offset;
+    VALUE ret = rb_alloc_rgba(rb_dest, rb_offset, w * h, &offset);
+    DecodeArgs args = {.w = w, .h = h, .flag = is2bpp};
+    DECODE_CHECK(decode_without_gvl(call_decode_pvrtc, &args, rb_data, ret, offset));
     return ret;
 }
 
+typedef struct {
+    const uint8_t *data;
+    long w;
+    long h;
+    int channels;
+    int level;
+    int filter;
+    uint8_t *png;
+    long png_len;
+    int result;
+} EncodePngCall;
+
+static void *encode_png_nogvl(void *ptr) {
+    EncodePngCall *call = (EncodePngCall *)ptr;
+    call->result = encode_png(call->data, call->w, call->h, call->channels, call->level, call->filter, &call->png,
+                              &call->png_len);
+    return NULL;
+}
+
+/*
+ * Encode raw pixels to PNG
+ * Rows are deflated in parallel when more than one decoder thread is set.
+ *
+ * @param [String] rb_data pixels to encode (top row first)
+ * @param [Integer] rb_w image width
+ * @param [Integer] rb_h image height
+ * @param [Integer] rb_channels number of channels (3 for RGB or 4 for RGBA)
+ * @param [Integer, nil] rb_level zlib compression level (0-9, or nil for the default)
+ * @param [Integer, nil] rb_filter PNG filter type (0-4, or 5 or nil for adaptive filtering)
+ * @return [String] PNG binary
+ */
+static VALUE rb_encode_png(int argc, VALUE *argv, VALUE self) {
+    rb_check_arity(argc, 4, 6);
+    VALUE rb_data = argv[0], rb_w = argv[1], rb_h = argv[2], rb_channels = argv[3];
+    VALUE rb_level = argc > 4 ? argv[4] : Qnil, rb_filter = argc > 5 ? argv[5] : Qnil;
+    long w = NUM2LONG(rb_w), h = NUM2LONG(rb_h);
+    int channels = NUM2INT(rb_channels);
+    int level = NIL_P(rb_level) ? PNG_LEVEL_DEFAULT : NUM2INT(rb_level);
+    int filter = NIL_P(rb_filter) ? PNG_FILTER_ADAPTIVE : NUM2INT(rb_filter);
+    if (w <= 0 || h <= 0 || w > 0x7fffffffL || h > 0x7fffffffL)
+        rb_raise(rb_eArgError, "Invalid image size.");
+    if (channels != 3 && channels != 4)
+        rb_raise(rb_eArgError, "Number of channels must be 3 or 4.");
+    if (level < PNG_LEVEL_DEFAULT || level > 9)
+        rb_raise(rb_eArgError, "Invalid compression level.");
+    if (filter < PNG_FILTER_NONE || filter > PNG_FILTER_ADAPTIVE)
+        rb_raise(rb_eArgError, "Invalid filter type.");
+    StringValue(rb_data);
+    if (!check_str_len(rb_data, w * h, channels))
+        return Qnil;
+    VALUE data = rb_str_new_frozen(rb_data);
+    EncodePngCall call = {(const uint8_t *)RSTRING_PTR(data), w, h, channels, level, filter, NULL, 0, 0};
+    rb_thread_call_without_gvl(encode_png_nogvl, &call, NULL, NULL);
+    RB_GC_GUARD(data);
+    DECODE_CHECK(call.result);
+    VALUE ret = rb_str_new((const char *)call.png, call.png_len);
+    free(call.png);
+    return ret;
+}
+
+typedef struct {
+    const uint8_t *src;
+    uint8_t *dest;
+    const StorageBlock *blocks;
+    long num_blocks;
+    int result;
+} DecompressCall;
+
+static void *decompress_nogvl(void *ptr) {
+    DecompressCall *call = (DecompressCall *)ptr;
+    call->result = decompress_storage_blocks(call->src, call->dest, call->blocks, call->num_blocks);
+    return NULL;
+}
+
+/*
+ * Decompress consecutive storage blocks of UnityFS into one string
+ * Blocks are decompressed in parallel when more than one decoder thread is set.
+ *
+ * @param [String] rb_data compressed blocks
+ * @param [Array<Array(Integer,Integer,Integer)>] rb_blocks uncompressed size, compressed size and flags of each block
+ * @return [String] concatenated uncompressed blocks
+ */
+static VALUE rb_decompress_blocks(VALUE self, VALUE rb_data, VALUE rb_blocks) {
+    StringValue(rb_data);
+    Check_Type(rb_blocks, T_ARRAY);
+    long num_blocks = RARRAY_LEN(rb_blocks), src_size = 0, dest_size = 0;
+    VALUE blocks_buf;
+    StorageBlock *blocks = ALLOCV_N(StorageBlock, blocks_buf, num_blocks > 0 ? num_blocks : 1);
+    for (long i = 0; i < num_blocks; i++) {
+        VALUE e = rb_ary_entry(rb_blocks, i);
+        Check_Type(e, T_ARRAY);
+        if (RARRAY_LEN(e) != 3)
+            rb_raise(rb_eArgError, "Block must be [uncompressed size, compressed size, flags].");
+        StorageBlock *b = blocks + i;
+        b->dest_size = NUM2LONG(rb_ary_entry(e, 0));
+        b->src_size = NUM2LONG(rb_ary_entry(e, 1));
+        b->flags = NUM2INT(rb_ary_entry(e, 2));
+        if (b->dest_size < 0 || b->src_size < 0 || b->dest_size > LONG_MAX - dest_size ||
+            b->src_size > LONG_MAX - src_size)
+            rb_raise(rb_eArgError, "Invalid block size.");
+        if (!storage_compression_supported(b->flags))
+            rb_raise(rb_eNotImpError, "Unsupported compression: %d", b->flags & UNITYFS_COMPRESSION_MASK);
+        b->src_offset = src_size;
+        b->dest_offset = dest_size;
+        src_size += b->src_size;
+        dest_size += b->dest_size;
+    }
+    if (!check_str_len(rb_data, src_size, 1))
+        return Qnil;
+    VALUE data = rb_str_new_frozen(rb_data);
+    VALUE ret = rb_str_buf_new(dest_size);
+    rb_str_set_len(ret, dest_size);
+    DecompressCall call = {(const uint8_t *)RSTRING_PTR(data), (uint8_t *)RSTRING_PTR(ret), blocks, num_blocks, 0};
+    rb_thread_call_without_gvl(decompress_nogvl, &call, NULL, NULL);
+    RB_GC_GUARD(data);
+    ALLOCV_END(blocks_buf);
+    DECODE_CHECK(call.result);
+    return ret;
+}
+
+/*
+ * Get the number of threads used to decode one block-compressed image
+ *
+ * @return [Integer] number of threads
+ */
+static VALUE rb_get_num_threads(VALUE self) {
+    return INT2FIX(get_decoder_threads());
+}
+
+/*
+ * Set the number of threads used to decode one block-compressed image (ASTC, ETC, EAC and DXT)
+ * The setting is process-wide and also applies to the PNG encoder and storage block decompression.
+ * 1 (default) decodes on the calling thread only, and 0 uses all online processors.
+ *
+ * @param [Integer] rb_num number of threads
+ * @return [Integer] number of threads
+ */
+static VALUE rb_set_num_threads(VALUE self, VALUE rb_num) {
+    set_decoder_threads(NUM2INT(rb_num));
+    return INT2FIX(get_decoder_threads());
+}
+
 void Init_native() {
     VALUE mMikunyan = rb_define_module("Mikunyan");
     VALUE mDecodeHelper = rb_define_module_under(mMikunyan, "DecodeHelper");
-    rb_define_module_function(mDecodeHelper, "decode_a8", rb_decode_a8, 2);
-    rb_define_module_function(mDecodeHelper, "decode_r8", rb_decode_r8, 2);
-    rb_define_module_function(mDecodeHelper, "decode_r16", rb_decode_r16, 3);
-    rb_define_module_function(mDecodeHelper, "decode_rgb565", rb_decode_rgb565, 3);
-    rb_define_module_function(mDecodeHelper, "decode_rhalf", rb_decode_rhalf, 3);
-    rb_define_module_function(mDecodeHelper, "decode_rghalf", rb_decode_rghalf, 3);
-    rb_define_module_function(mDecodeHelper, "decode_rgbahalf", rb_decode_rgbahalf, 3);
-    rb_define_module_function(mDecodeHelper, "decode_etc1", rb_decode_etc1, 3);
-    rb_define_module_function(mDecodeHelper, "decode_etc2", rb_decode_etc2, 3);
-    rb_define_module_function(mDecodeHelper, "decode_etc2a1", rb_decode_etc2a1, 3);
-    rb_define_module_function(mDecodeHelper, "decode_etc2a8", rb_decode_etc2a8, 3);
-    rb_define_module_function(mDecodeHelper, "decode_eacr", rb_decode_eacr, 3);
-    rb_define_module_function(mDecodeHelper, "decode_eacsr", rb_decode_eacsr, 3);
-    rb_define_module_function(mDecodeHelper, "decode_eacrg", rb_decode_eacrg, 3);
-    rb_define_module_function(mDecodeHelper, "decode_eacsrg", rb_decode_eacsrg, 3);
-    rb_define_module_function(mDecodeHelper, "decode_astc", rb_decode_astc, 5);
-    rb_define_module_function(mDecodeHelper, "decode_dxt1", rb_decode_dxt1, 3);
-    rb_define_module_function(mDecodeHelper, "decode_dxt5", rb_decode_dxt5, 3);
-    rb_define_module_function(mDecodeHelper, "decode_pvrtc1", rb_decode_pvrtc1, 4);
+    rb_define_module_function(mDecodeHelper, "decode_a8", rb_decode_a8, -1);
+    rb_define_module_function(mDecodeHelper, "decode_r8", rb_decode_r8, -1);
+    rb_define_module_function(mDecodeHelper, "decode_r16", rb_decode_r16, -1);
+    rb_define_module_function(mDecodeHelper, "decode_rgb565", rb_decode_rgb565, -1);
+    rb_define_module_function(mDecodeHelper, "decode_rhalf", rb_decode_rhalf, -1);
+    rb_define_module_function(mDecodeHelper, "decode_rghalf", rb_decode_rghalf, -1);
+    rb_define_module_function(mDecodeHelper, "decode_rgbahalf", rb_decode_rgbahalf, -1);
+    rb_define_module_function(mDecodeHelper, "decode_argb32", rb_decode_argb32, -1);
+    rb_define_module_function(mDecodeHelper, "decode_bgra32", rb_decode_bgra32, -1);
+    rb_define_module_function(mDecodeHelper, "decode_argb4444", rb_decode_argb4444, -1);
+    rb_define_module_function(mDecodeHelper, "decode_rgba4444", rb_decode_rgba4444, -1);
+    rb_define_module_function(mDecodeHelper, "decode_rg16", rb_decode_rg16, -1);
+    rb_define_module_function(mDecodeHelper, "decode_rfloat", rb_decode_rfloat, -1);
+    rb_define_module_function(mDecodeHelper, "decode_rgfloat", rb_decode_rgfloat, -1);
+    rb_define_module_function(mDecodeHelper, "decode_rgbafloat", rb_decode_rgbafloat, -1);
+    rb_define_module_function(mDecodeHelper, "decode_rgb9e5float", rb_decode_rgb9e5float, -1);
+    rb_define_module_function(mDecodeHelper, "flip_image", rb_flip_image, -1);
+    rb_define_module_function(mDecodeHelper, "decode_etc1", rb_decode_etc1, -1);
+    rb_define_module_function(mDecodeHelper, "decode_etc2", rb_decode_etc2, -1);
+    rb_define_module_function(mDecodeHelper, "decode_etc2a1", rb_decode_etc2a1, -1);
+    rb_define_module_function(mDecodeHelper, "decode_etc2a8", rb_decode_etc2a8, -1);
+    rb_define_module_function(mDecodeHelper, "decode_eacr", rb_decode_eacr, -1);
+    rb_define_module_function(mDecodeHelper, "decode_eacsr", rb_decode_eacsr, -1);
+    rb_define_module_function(mDecodeHelper, "decode_eacrg", rb_decode_eacrg, -1);
+    rb_define_module_function(mDecodeHelper, "decode_eacsrg", rb_decode_eacsrg, -1);
+    rb_define_module_function(mDecodeHelper, "decode_astc", rb_decode_astc, -1);
+    rb_define_module_function(mDecodeHelper, "decode_dxt1", rb_decode_dxt1, -1);
+    rb_define_module_function(mDecodeHelper, "decode_dxt5", rb_decode_dxt5, -1);
+    rb_define_module_function(mDecodeHelper, "decode_bc4", rb_decode_bc4, -1);
+    rb_define_module_function(mDecodeHelper, "decode_bc5", rb_decode_bc5, -1);
+    rb_define_module_function(mDecodeHelper, "decode_bc6h", rb_decode_bc6h, -1);
+    rb_define_module_function(mDecodeHelper, "decode_bc7", rb_decode_bc7, -1);
+    rb_define_module_function(mDecodeHelper, "decode_pvrtc1", rb_decode_pvrtc1, -1);
+    rb_define_module_function(mDecodeHelper, "encode_png", rb_encode_png, -1);
+    rb_define_module_function(mDecodeHelper, "decompress_blocks", rb_decompress_blocks, 2);
+    rb_define_module_function(mDecodeHelper, "num_threads", rb_get_num_threads, 0);
+    rb_define_module_function(mDecodeHelper, "num_threads=", rb_set_num_threads, 1);
+
+    VALUE compressions = rb_ary_new();
+    for (int flags = 0; flags <= UNITYFS_COMPRESSION_MASK; flags++)
+        if (storage_compression_supported(flags))
+            rb_ary_push(compressions, INT2FIX(flags));
+    rb_define_const(mDecodeHelper, "BLOCK_COMPRESSIONS", rb_obj_freeze(compressions));
+
+    Init_binary_reader(mMikunyan);
+    Init_type_tree(mMikunyan);
+    Init_object_parser(mMikunyan);
+    Init_mapped_file(mMikunyan);
 }
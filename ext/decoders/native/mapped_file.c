@@ -0,0 +1,169 @@
+#include "mapped_file.h"
+#ifdef HAVE_SYS_MMAN_H
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+typedef struct {
+    void *map;
+    size_t map_len;
+    const char *ptr;
+    long len;
+    VALUE parent;
+} MappedFile;
+
+static ID id_mapping;
+
+static void mapped_file_mark(void *ptr) {
+    rb_gc_mark(((MappedFile *)ptr)->parent);
+}
+
+static void mapped_file_free(void *ptr) {
+    MappedFile *m = (MappedFile *)ptr;
+    if (m->map)
+        munmap(m->map, m->map_len);
+    xfree(m);
+}
+
+static size_t mapped_file_size(const void *ptr) {
+    return sizeof(MappedFile);
+}
+
+static const rb_data_type_t mapped_file_type = {
+    "Mikunyan::MappedFile",
+    {mapped_file_mark, mapped_file_free, mapped_file_size},
+    NULL,
+    NULL,
+    RUBY_TYPED_FREE_IMMEDIATELY,
+};
+
+static VALUE rb_mapped_file_alloc(VALUE klass) {
+    MappedFile *m;
+    VALUE self = TypedData_Make_Struct(klass, MappedFile, &mapped_file_type, m);
+    m->parent = Qnil;
+    return self;
+}
+
+static MappedFile *get_mapped_file(VALUE self) {
+    MappedFile *m;
+    TypedData_Get_Struct(self, MappedFile, &mapped_file_type, m);
+    return m;
+}
+
+static void check_mapped_range(const MappedFile *m, long offset, long len) {
+    if (offset < 0 || len < 0 || offset > m->len || len > m->len - offset)
+        rb_raise(rb_eEOFError, "Out of the mapped range.");
+}
+
+/*
+ * Map a file into memory (read-only)
+ * The mapping is released when neither the object nor any view of it is referred.
+ *
+ * @param [String] rb_path file path
+ */
+static VALUE rb_mapped_file_initialize(VALUE self, VALUE rb_path) {
+    MappedFile *m = get_mapped_file(self);
+    if (m->ptr)
+        rb_raise(rb_eRuntimeError, "Already mapped.");
+    FilePathValue(rb_path);
+    int fd = open(StringValueCStr(rb_path), O_RDONLY | O_CLOEXEC);
+    if (fd < 0)
+        rb_sys_fail_str(rb_path);
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+        int e = errno;
+        close(fd);
+        errno = e;
+        rb_sys_fail_str(rb_path);
+    }
+    if (st.st_size > 0) {
+        void *map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (map == MAP_FAILED) {
+            int e = errno;
+            close(fd);
+            errno = e;
+            rb_sys_fail_str(rb_path);
+        }
+        m->map = map;
+        m->map_len = st.st_size;
+    }
+    close(fd);
+    m->ptr = m->map ? m->map : "";
+    m->len = st.st_size;
+    return self;
+}
+
+/*
+ * Get the size of the mapped range
+ *
+ * @return [Integer] size
+ */
+static VALUE rb_mapped_file_bytesize(VALUE self) {
+    return LONG2NUM(get_mapped_file(self)->len);
+}
+
+/*
+ * Get a frozen string which refers to the mapped memory without copying
+ * The view keeps the mapping alive, and so do strings sharing it (e.g. its dup).
+ *
+ * @param [Integer] rb_offset offset (0 if omitted)
+ * @param [Integer] rb_size size (up to the end if omitted)
+ * @return [String] view
+ */
+static VALUE rb_mapped_file_view(int argc, VALUE *argv, VALUE self) {
+    rb_check_arity(argc, 0, 2);
+    const MappedFile *m = get_mapped_file(self);
+    long offset = argc > 0 ? NUM2LONG(argv[0]) : 0;
+    long len = argc > 1 ? NUM2LONG(argv[1]) : m->len - offset;
+    check_mapped_range(m, offset, len);
+    VALUE str = rb_str_new_static(m->ptr + offset, len);
+    rb_ivar_set(str, id_mapping, self);
+    return rb_obj_freeze(str);
+}
+
+/*
+ * Same as view, with arguments in the order of IO#pread
+ *
+ * @param [Integer] rb_size size
+ * @param [Integer] rb_offset offset
+ * @return [String] view
+ */
+static VALUE rb_mapped_file_pread(VALUE self, VALUE rb_size, VALUE rb_offset) {
+    VALUE argv[] = {rb_offset, rb_size};
+    return rb_mapped_file_view(2, argv, self);
+}
+
+/*
+ * Get a part of the mapped range as a MappedFile
+ *
+ * @param [Integer] rb_offset offset
+ * @param [Integer] rb_size size
+ * @return [Mikunyan::MappedFile] part of the range
+ */
+static VALUE rb_mapped_file_slice(VALUE self, VALUE rb_offset, VALUE rb_size) {
+    const MappedFile *m = get_mapped_file(self);
+    long offset = NUM2LONG(rb_offset), len = NUM2LONG(rb_size);
+    check_mapped_range(m, offset, len);
+    VALUE ret = rb_mapped_file_alloc(rb_obj_class(self));
+    MappedFile *s = get_mapped_file(ret);
+    s->ptr = m->ptr + offset;
+    s->len = len;
+    RB_OBJ_WRITE(ret, &s->parent, NIL_P(m->parent) ? self : m->parent);
+    return ret;
+}
+
+void Init_mapped_file(VALUE mMikunyan) {
+    id_mapping = rb_intern("mapping");
+    VALUE cMappedFile = rb_define_class_under(mMikunyan, "MappedFile", rb_cObject);
+    rb_define_alloc_func(cMappedFile, rb_mapped_file_alloc);
+    rb_define_method(cMappedFile, "initialize", rb_mapped_file_initialize, 1);
+    rb_define_method(cMappedFile, "bytesize", rb_mapped_file_bytesize, 0);
+    rb_define_method(cMappedFile, "view", rb_mapped_file_view, -1);
+    rb_define_method(cMappedFile, "pread", rb_mapped_file_pread, 2);
+    rb_define_method(cMappedFile, "slice", rb_mapped_file_slice, 2);
+}
+#else
+void Init_mapped_file(VALUE mMikunyan) {}
+#endif
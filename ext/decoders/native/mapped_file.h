@@ -0,0 +1,8 @@
+#ifndef MAPPED_FILE_H
+#define MAPPED_FILE_H
+
+#include <ruby.h>
+
+void Init_mapped_file(VALUE);
+
+#endif /* end of include guard: MAPPED_FILE_H */
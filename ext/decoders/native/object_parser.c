@@ -0,0 +1,973 @@
+#include "object_parser.h"
+#include <stdint.h>
+#include <string.h>
+#include "binary_reader.h"
+#include "type_tree.h"
+
+enum {
+    OP_BOOL,
+    OP_I8S,
+    OP_I8U,
+    OP_I16S,
+    OP_I16U,
+    OP_I32S,
+    OP_I32U,
+    OP_I64S,
+    OP_I64U,
+    OP_FLOAT,
+    OP_DOUBLE,
+    OP_BYTES,
+    OP_ARRAY,
+    OP_WRAPPER,
+    OP_STRUCT,
+    OP_STREAMING_INFO
+};
+
+// how the data of an array is read at once instead of element by element
+// (primitives are kept packed only if requested)
+enum { BULK_NONE, BULK_BYTES, BULK_STRING, BULK_PACKED };
+
+// sizes of primitives (OP_BOOL to OP_DOUBLE)
+static const long leaf_sizes[] = {1, 1, 1, 2, 2, 4, 4, 8, 8, 4, 8};
+
+// children of an array named size and data
+enum { ROLE_NONE, ROLE_SIZE, ROLE_DATA };
+
+/*
+ * Compiled TypeTree node
+ * Children of a node are stored contiguously from first_child.
+ */
+typedef struct {
+    int op;
+    int align;
+    int role;
+    VALUE name;
+    VALUE type;
+    VALUE key;
+    long size;
+    // size of the data if it does not depend on the content or position (plain data), or -1
+    long fixed_size;
+    long first_child;
+    long num_children;
+    // offset from the parent if all the preceding siblings are plain data, or -1
+    long offset;
+    // array only
+    long data_child;
+    int bulk;
+    int bulk_align;
+} ParserOp;
+
+typedef struct {
+    ParserOp *ops;
+    long num_ops;
+    int compiled;
+} ObjectParser;
+
+typedef struct {
+    const uint8_t *ptr;
+    long len;
+    long pos;
+    int little;
+    VALUE endian;
+    VALUE asset;
+    VALUE value_class;
+    VALUE parser;
+    VALUE data;
+    // whether structs are parsed into LazyStruct (not in arrays)
+    int lazy;
+    // whether arrays of primitives are parsed into PackedArray
+    int packed;
+} ParseState;
+
+/*
+ * Children of a struct which are decoded on demand
+ * Offsets of children are found when they are accessed first. A child after plain data has a fixed offset,
+ * and others are found by skipping the preceding children, whose offsets are recorded.
+ */
+typedef struct {
+    VALUE parser;
+    VALUE data;
+    VALUE endian;
+    VALUE asset;
+    VALUE value_class;
+    long op;
+    long num_children;
+    long start;
+    int packed;
+    // offsets[0..num_known] are known
+    long num_known;
+    long *offsets;
+} LazyStruct;
+
+/*
+ * Array of primitives kept as binary data
+ * Elements are decoded when they are read, so no object is created for each element.
+ */
+typedef struct {
+    VALUE data;
+    VALUE type;
+    VALUE endian;
+    int op;
+    int little;
+    long count;
+} PackedArray;
+
+static ID id_get_stream_blob;
+static ID id_iv_name, id_iv_type, id_iv_endian, id_iv_value, id_iv_is_struct, id_iv_attr, id_iv_lazy;
+static VALUE str_data, cLazyStruct, cPackedArray;
+
+static void object_parser_mark(void *ptr) {
+    const ObjectParser *p = (const ObjectParser *)ptr;
+    for (long i = 0; i < p->num_ops; i++) {
+        rb_gc_mark(p->ops[i].name);
+        rb_gc_mark(p->ops[i].type);
+        rb_gc_mark(p->ops[i].key);
+    }
+}
+
+static void object_parser_free(void *ptr) {
+    xfree(((ObjectParser *)ptr)->ops);
+    xfree(ptr);
+}
+
+static size_t object_parser_size(const void *ptr) {
+    return sizeof(ObjectParser) + ((const ObjectParser *)ptr)->num_ops * sizeof(ParserOp);
+}
+
+static const rb_data_type_t object_parser_type = {
+    "Mikunyan::ObjectParser",
+    {object_parser_mark, object_parser_free, object_parser_size},
+    NULL,
+    NULL,
+    RUBY_TYPED_FREE_IMMEDIATELY,
+};
+
+static VALUE rb_object_parser_alloc(VALUE klass) {
+    ObjectParser *p;
+    return TypedData_Make_Struct(klass, ObjectParser, &object_parser_type, p);
+}
+
+static ObjectParser *get_object_parser(VALUE self) {
+    ObjectParser *p;
+    TypedData_Get_Struct(self, ObjectParser, &object_parser_type, p);
+    if (!p->compiled)
+        rb_raise(rb_eRuntimeError, "Parser is not compiled.");
+    return p;
+}
+
+static int str_eq(VALUE str, const char *s) {
+    long len = strlen(s);
+    return RB_TYPE_P(str, T_STRING) && RSTRING_LEN(str) == len && memcmp(RSTRING_PTR(str), s, len) == 0;
+}
+
+static int leaf_op(VALUE type) {
+    static const struct {
+        const char *name;
+        int op;
+    } table[] = {
+        {"bool", OP_BOOL},
+        {"SInt8", OP_I8S},
+        {"UInt8", OP_I8U},
+        {"SInt16", OP_I16S},
+        {"short", OP_I16S},
+        {"UInt16", OP_I16U},
+        {"unsigned short", OP_I16U},
+        {"SInt32", OP_I32S},
+        {"int", OP_I32S},
+        {"UInt32", OP_I32U},
+        {"unsigned int", OP_I32U},
+        {"Type*", OP_I32U},
+        {"SInt64", OP_I64S},
+        {"long long", OP_I64S},
+        {"UInt64", OP_I64U},
+        {"unsigned long long", OP_I64U},
+        {"float", OP_FLOAT},
+        {"double", OP_DOUBLE},
+    };
+    for (size_t i = 0; i < sizeof(table) / sizeof(table[0]); i++)
+        if (str_eq(type, table[i].name))
+            return table[i].op;
+    return OP_BYTES;
+}
+
+static void set_parser_op(ParserOp *op, const TreeNode *node) {
+    op->name = node->name;
+    op->type = node->type;
+    // frozen keys are stored in Hash without being copied
+    op->key = RB_TYPE_P(op->name, T_STRING) ? rb_str_new_frozen(op->name) : op->name;
+    op->size = node->size;
+    op->align = (node->flags & 0x4000) != 0;
+    op->role = str_eq(op->name, "size") ? ROLE_SIZE : str_eq(op->name, "data") ? ROLE_DATA : ROLE_NONE;
+    op->data_child = -1;
+    op->offset = -1;
+}
+
+/*
+ * Returns the size of plain data (primitives and structs of them without alignment), or -1
+ * The children must be compiled.
+ */
+static long fixed_size(const ObjectParser *p, const ParserOp *op) {
+    if (op->align)
+        return -1;
+    if (op->op <= OP_BYTES)
+        return op->size;
+    if (op->op != OP_STRUCT)
+        return -1;
+    long size = 0;
+    for (long i = 0; i < op->num_children; i++) {
+        long child = p->ops[op->first_child + i].fixed_size;
+        if (child < 0 || child > LONG_MAX - size)
+            return -1;
+        size += child;
+    }
+    return size;
+}
+
+/*
+ * Compiles the children of nodes[node] into ops[index]
+ * next[i] is the index after the subtree of nodes[i], where its next sibling is if any.
+ * Children are appended to ops, and then their children are compiled recursively.
+ */
+static void compile_children(ObjectParser *p, long index, const NodeArray *a, const long *next, long node,
+                             long *capa) {
+    long n = 0;
+    for (long c = node + 1; c < next[node]; c = next[c])
+        n++;
+    if (p->num_ops + n > *capa) {
+        long old_capa = *capa;
+        while (p->num_ops + n > *capa)
+            *capa *= 2;
+        REALLOC_N(p->ops, ParserOp, *capa);
+        // ops are marked while compiling, so unused ones must be cleared
+        memset(p->ops + old_capa, 0, (*capa - old_capa) * sizeof(ParserOp));
+    }
+    long first = p->num_ops;
+    p->num_ops += n;
+    ParserOp *op = p->ops + index;
+    op->first_child = first;
+    op->num_children = n;
+    for (long i = 0, c = node + 1; i < n; i++, c = next[c])
+        set_parser_op(p->ops + first + i, a->nodes + c);
+
+    if (n == 0) {
+        op->op = leaf_op(op->type);
+    } else if (a->nodes[node].is_array) {
+        op->op = OP_ARRAY;
+        op->bulk = BULK_NONE;
+        for (long i = 0; i < n; i++) {
+            const ParserOp *child = p->ops + first + i;
+            if (child->role != ROLE_DATA)
+                continue;
+            op->data_child = first + i;
+            op->bulk_align = child->align;
+            if (str_eq(op->type, "TypelessData"))
+                op->bulk = BULK_BYTES;
+            else if (str_eq(child->type, "char"))
+                op->bulk = BULK_STRING;
+        }
+    } else if (n == 1 && a->nodes[node + 1].is_array &&
+               str_eq(p->ops[first].type, "Array") && str_eq(p->ops[first].name, "Array")) {
+        op->op = OP_WRAPPER;
+    } else {
+        op->op = str_eq(op->type, "StreamingInfo") ? OP_STREAMING_INFO : OP_STRUCT;
+    }
+
+    for (long i = 0, c = node + 1; i < n; i++, c = next[c])
+        compile_children(p, first + i, a, next, c, capa);
+    // bulk reading needs the data node to be a leaf, which is known after compiling it
+    op = p->ops + index;
+    if (op->op == OP_ARRAY && op->data_child >= 0 && p->ops[op->data_child].num_children > 0)
+        op->bulk = BULK_NONE;
+    if (op->op == OP_ARRAY && op->data_child >= 0 && op->bulk == BULK_NONE) {
+        const ParserOp *data = p->ops + op->data_child;
+        if (data->op < OP_BYTES && !data->align && data->size == leaf_sizes[data->op])
+            op->bulk = BULK_PACKED;
+    }
+    op->fixed_size = fixed_size(p, op);
+    long offset = 0;
+    for (long i = 0; i < n && offset >= 0; i++) {
+        ParserOp *child = p->ops + first + i;
+        child->offset = offset;
+        offset = child->fixed_size < 0 || child->fixed_size > LONG_MAX - offset ? -1 : offset + child->fixed_size;
+    }
+}
+
+/*
+ * Compile a TypeTree into a parser
+ * The nodes are read once, so the parser does not follow later changes of them.
+ *
+ * @param [Mikunyan::TypeTree::Node,Mikunyan::TypeTree::NodeArray] rb_node root node or compact nodes
+ */
+static VALUE rb_object_parser_initialize(VALUE self, VALUE rb_node) {
+    ObjectParser *p;
+    TypedData_Get_Struct(self, ObjectParser, &object_parser_type, p);
+    if (p->ops)
+        rb_raise(rb_eRuntimeError, "Already compiled.");
+    VALUE nodes = to_node_array(rb_node);
+    const NodeArray *a = get_node_array(nodes);
+    if (a->count == 0)
+        rb_raise(rb_eArgError, "TypeTree has no nodes.");
+
+    VALUE next_buf;
+    long *next = ALLOCV_N(long, next_buf, a->count);
+    for (long i = a->count - 1; i >= 0; i--) {
+        long j = i + 1;
+        while (j < a->count && a->nodes[j].level > a->nodes[i].level)
+            j = next[j];
+        next[i] = j;
+    }
+    long capa = 64;
+    p->ops = ZALLOC_N(ParserOp, capa);
+    p->num_ops = 1;
+    set_parser_op(p->ops, a->nodes);
+    compile_children(p, 0, a, next, 0, &capa);
+    p->compiled = 1;
+    ALLOCV_END(next_buf);
+    RB_GC_GUARD(nodes);
+    return self;
+}
+
+static inline const uint8_t *parse_advance(ParseState *s, long size) {
+    if (size < 0 || s->pos > s->len - size)
+        rb_raise(rb_eEOFError, "End of data reached.");
+    const uint8_t *ptr = s->ptr + s->pos;
+    s->pos += size;
+    return ptr;
+}
+
+static VALUE new_object_value(VALUE klass, const ParserOp *op, const ParseState *s) {
+    // the root may be of a custom type whose initialize must run
+    if (klass != s->value_class) {
+        VALUE args[] = {op->name, op->type, s->endian};
+        return rb_class_new_instance(3, args, klass);
+    }
+    VALUE obj = rb_obj_alloc(klass);
+    // same order as ObjectValue#initialize
+    rb_ivar_set(obj, id_iv_name, op->name);
+    rb_ivar_set(obj, id_iv_type, op->type);
+    rb_ivar_set(obj, id_iv_endian, s->endian);
+    rb_ivar_set(obj, id_iv_value, Qnil);
+    rb_ivar_set(obj, id_iv_is_struct, Qfalse);
+    rb_ivar_set(obj, id_iv_attr, rb_hash_new());
+    return obj;
+}
+
+static void lazy_struct_mark(void *ptr) {
+    const LazyStruct *l = (const LazyStruct *)ptr;
+    rb_gc_mark(l->parser);
+    rb_gc_mark(l->data);
+    rb_gc_mark(l->endian);
+    rb_gc_mark(l->asset);
+    rb_gc_mark(l->value_class);
+}
+
+static void lazy_struct_free(void *ptr) {
+    xfree(((LazyStruct *)ptr)->offsets);
+    xfree(ptr);
+}
+
+static size_t lazy_struct_size(const void *ptr) {
+    const LazyStruct *l = (const LazyStruct *)ptr;
+    return sizeof(LazyStruct) + (l->offsets ? (l->num_children + 1) * sizeof(long) : 0);
+}
+
+static const rb_data_type_t lazy_struct_type = {
+    "Mikunyan::ObjectParser::LazyStruct",
+    {lazy_struct_mark, lazy_struct_free, lazy_struct_size},
+    NULL,
+    NULL,
+    RUBY_TYPED_FREE_IMMEDIATELY,
+};
+
+/*
+ * Creates a struct ObjectValue whose children are decoded when they are accessed
+ * The position is not advanced.
+ */
+static VALUE new_lazy_struct(const ParseState *s, const ObjectParser *p, const ParserOp *op, VALUE klass) {
+    VALUE ret = new_object_value(klass, op, s);
+    rb_ivar_set(ret, id_iv_is_struct, Qtrue);
+    LazyStruct *l;
+    VALUE lazy = TypedData_Make_Struct(cLazyStruct, LazyStruct, &lazy_struct_type, l);
+    l->parser = s->parser;
+    l->data = s->data;
+    l->endian = s->endian;
+    l->asset = s->asset;
+    l->value_class = s->value_class;
+    l->op = op - p->ops;
+    l->start = s->pos;
+    l->packed = s->packed;
+    l->offsets = ALLOC_N(long, op->num_children + 1);
+    l->num_children = op->num_children;
+    l->offsets[0] = s->pos;
+    rb_ivar_set(ret, id_iv_lazy, lazy);
+    return ret;
+}
+
+static void packed_array_mark(void *ptr) {
+    const PackedArray *a = (const PackedArray *)ptr;
+    rb_gc_mark(a->data);
+    rb_gc_mark(a->type);
+    rb_gc_mark(a->endian);
+}
+
+static size_t packed_array_size(const void *ptr) {
+    return sizeof(PackedArray);
+}
+
+static const rb_data_type_t packed_array_type = {
+    "Mikunyan::PackedArray",
+    {packed_array_mark, RUBY_TYPED_DEFAULT_FREE, packed_array_size},
+    NULL,
+    NULL,
+    RUBY_TYPED_FREE_IMMEDIATELY,
+};
+
+// creates PackedArray of count elements of op at pos (the range must be checked)
+static VALUE new_packed_array(const ParseState *s, const ParserOp *op, long pos, long count) {
+    PackedArray *a;
+    VALUE ret = TypedData_Make_Struct(cPackedArray, PackedArray, &packed_array_type, a);
+    a->type = op->type;
+    a->endian = s->endian;
+    a->op = op->op;
+    a->little = s->little;
+    a->count = count;
+    a->data = rb_obj_freeze(str_view(s->data, pos, count * leaf_sizes[op->op]));
+    return ret;
+}
+
+// decodes a primitive (op < OP_BYTES)
+static inline VALUE leaf_value(const uint8_t *ptr, int op, int little) {
+    uint16_t u16;
+    uint32_t u32;
+    uint64_t u64;
+    float f;
+    double d;
+    switch (op) {
+    case OP_BOOL:
+        return *ptr ? Qtrue : Qfalse;
+    case OP_I8S:
+        return INT2FIX((int8_t)*ptr);
+    case OP_I8U:
+        return INT2FIX(*ptr);
+    case OP_I16S:
+    case OP_I16U:
+        memcpy(&u16, ptr, 2);
+        u16 = little ? lton16(u16) : bton16(u16);
+        return op == OP_I16S ? INT2FIX((int16_t)u16) : INT2FIX(u16);
+    case OP_I32S:
+    case OP_I32U:
+    case OP_FLOAT:
+        memcpy(&u32, ptr, 4);
+        u32 = little ? lton32(u32) : bton32(u32);
+        if (op == OP_FLOAT) {
+            memcpy(&f, &u32, 4);
+            return DBL2NUM(f);
+        }
+        return op == OP_I32S ? INT2NUM((int32_t)u32) : UINT2NUM(u32);
+    default:
+        memcpy(&u64, ptr, 8);
+        u64 = little ? lton64(u64) : bton64(u64);
+        if (op == OP_DOUBLE) {
+            memcpy(&d, &u64, 8);
+            return DBL2NUM(d);
+        }
+        return op == OP_I64S ? LL2NUM((int64_t)u64) : ULL2NUM(u64);
+    }
+}
+
+static VALUE parse_leaf(ParseState *s, const ParserOp *op) {
+    long pos = s->pos;
+    VALUE ret;
+    if (op->op < OP_BYTES)
+        ret = leaf_value(parse_advance(s, leaf_sizes[op->op]), op->op, s->little);
+    else
+        ret = rb_str_new((const char *)parse_advance(s, op->size), op->size);
+    // the node size takes precedence over the size of the value
+    if (op->size >= 0)
+        s->pos = pos + op->size;
+    return ret;
+}
+
+static VALUE parse_node(ParseState *s, const ObjectParser *p, const ParserOp *op, VALUE klass);
+static void skip_node(ParseState *s, const ObjectParser *p, const ParserOp *op);
+
+static VALUE parse_array(ParseState *s, const ObjectParser *p, const ParserOp *op, VALUE ret) {
+    VALUE attr = rb_ivar_get(ret, id_iv_attr);
+    VALUE size_obj = Qnil;
+    // elements of an array are usually read all together, so they are not parsed lazily
+    int lazy = s->lazy;
+    s->lazy = 0;
+    for (long i = 0; i < op->num_children; i++) {
+        long index = op->first_child + i;
+        const ParserOp *child = p->ops + index;
+        if (child->role != ROLE_DATA) {
+            VALUE v = parse_node(s, p, child, s->value_class);
+            if (child->role == ROLE_SIZE)
+                size_obj = v;
+            rb_hash_aset(attr, child->key, v);
+            continue;
+        }
+
+        VALUE rb_size = NIL_P(size_obj) ? Qnil : rb_ivar_get(size_obj, id_iv_value);
+        if (NIL_P(rb_size))
+            rb_raise(rb_eRuntimeError, "`size` node must appear before `data` node in array node");
+        long size = NUM2LONG(rb_size);
+        if (size < 0)
+            rb_raise(rb_eArgError, "negative array size");
+        VALUE value = Qnil;
+        if (index == op->data_child && op->bulk == BULK_PACKED && s->packed) {
+            if (size > LONG_MAX / child->size)
+                rb_raise(rb_eEOFError, "End of data reached.");
+            long pos = s->pos;
+            parse_advance(s, size * child->size);
+            value = new_packed_array(s, child, pos, size);
+        } else if (index == op->data_child && (op->bulk == BULK_BYTES || op->bulk == BULK_STRING) &&
+                   (!op->bulk_align || (s->pos % 4 == 0 && child->size % 4 == 0))) {
+            if (child->size < 0 || (child->size > 0 && size > LONG_MAX / child->size))
+                rb_raise(rb_eEOFError, "End of data reached.");
+            long len = size * child->size, pos = s->pos;
+            const char *ptr = (const char *)parse_advance(s, len);
+            // TypelessData (such as image data) refers to the object data
+            value = op->bulk == BULK_BYTES ? str_view(s->data, pos, len) : rb_utf8_str_new(ptr, len);
+        } else {
+            // an array of plain data which exceeds the rest is broken before reading any element
+            if (child->fixed_size > 0 && size > 0 && size > (s->len - s->pos) / child->fixed_size)
+                rb_raise(rb_eEOFError, "End of data reached.");
+            value = rb_ary_new_capa(child->fixed_size > 0 || size < 4096 ? size : 4096);
+            for (long j = 0; j < size; j++)
+                rb_ary_push(value, parse_node(s, p, child, s->value_class));
+        }
+        rb_ivar_set(ret, id_iv_value, value);
+        rb_hash_aset(attr, str_data, value);
+    }
+    s->lazy = lazy;
+    return ret;
+}
+
+static VALUE parse_node(ParseState *s, const ObjectParser *p, const ParserOp *op, VALUE klass) {
+    VALUE ret;
+    if (op->op == OP_WRAPPER) {
+        ret = parse_node(s, p, p->ops + op->first_child, s->value_class);
+        rb_ivar_set(ret, id_iv_name, op->name);
+        rb_ivar_set(ret, id_iv_type, op->type);
+    } else if (op->op == OP_STRUCT && s->lazy) {
+        ret = new_lazy_struct(s, p, op, klass);
+        // skip_node also aligns the position
+        skip_node(s, p, op);
+        return ret;
+    } else {
+        ret = new_object_value(klass, op, s);
+        if (op->op < OP_ARRAY) {
+            rb_ivar_set(ret, id_iv_value, parse_leaf(s, op));
+        } else if (op->op == OP_ARRAY) {
+            parse_array(s, p, op, ret);
+        } else {
+            VALUE attr = rb_hash_new();
+            for (long i = 0; i < op->num_children; i++) {
+                const ParserOp *child = p->ops + op->first_child + i;
+                rb_hash_aset(attr, child->key, parse_node(s, p, child, s->value_class));
+            }
+            rb_ivar_set(ret, id_iv_attr, attr);
+            if (op->op == OP_STREAMING_INFO) {
+                VALUE args[3];
+                const char *keys[] = {"path", "offset", "size"};
+                for (int i = 0; i < 3; i++) {
+                    VALUE v = rb_hash_lookup(attr, rb_str_new_cstr(keys[i]));
+                    args[i] = NIL_P(v) ? Qnil : rb_ivar_get(v, id_iv_value);
+                }
+                rb_ivar_set(ret, id_iv_value, NIL_P(s->asset) ? Qnil : rb_funcallv(s->asset, id_get_stream_blob, 3, args));
+            } else {
+                rb_ivar_set(ret, id_iv_is_struct, Qtrue);
+            }
+        }
+    }
+    if (op->align && s->pos % 4)
+        s->pos += 4 - s->pos % 4;
+    return ret;
+}
+
+static inline void skip_bytes(ParseState *s, long size) {
+    if (size < 0 || s->pos > s->len - size)
+        rb_raise(rb_eEOFError, "End of data reached.");
+    s->pos += size;
+}
+
+/*
+ * Advances the position over a node without creating ObjectValue
+ * Plain data and arrays of it are skipped by their sizes, and only sizes of other arrays are read.
+ */
+static void skip_node(ParseState *s, const ObjectParser *p, const ParserOp *op) {
+    if (op->fixed_size >= 0) {
+        skip_bytes(s, op->fixed_size);
+        return;
+    }
+    if (op->op < OP_ARRAY) {
+        if (op->size >= 0)
+            skip_bytes(s, op->size);
+        else
+            parse_leaf(s, op);
+    } else if (op->op == OP_ARRAY) {
+        VALUE rb_size = Qnil;
+        for (long i = 0; i < op->num_children; i++) {
+            long index = op->first_child + i;
+            const ParserOp *child = p->ops + index;
+            if (child->role == ROLE_SIZE) {
+                rb_size = rb_ivar_get(parse_node(s, p, child, s->value_class), id_iv_value);
+                continue;
+            } else if (child->role != ROLE_DATA) {
+                skip_node(s, p, child);
+                continue;
+            }
+            if (NIL_P(rb_size))
+                rb_raise(rb_eRuntimeError, "`size` node must appear before `data` node in array node");
+            long size = NUM2LONG(rb_size);
+            if (size < 0)
+                rb_raise(rb_eArgError, "negative array size");
+            long unit = -1;
+            if (index == op->data_child && op->bulk != BULK_NONE &&
+                (!op->bulk_align || (s->pos % 4 == 0 && child->size % 4 == 0)))
+                unit = child->size;
+            else if (child->fixed_size >= 0)
+                unit = child->fixed_size;
+            if (unit >= 0) {
+                if (unit > 0 && size > LONG_MAX / unit)
+                    rb_raise(rb_eEOFError, "End of data reached.");
+                skip_bytes(s, size * unit);
+            } else {
+                for (long j = 0; j < size; j++)
+                    skip_node(s, p, child);
+            }
+        }
+    } else {
+        for (long i = 0; i < op->num_children; i++)
+            skip_node(s, p, p->ops + op->first_child + i);
+    }
+    if (op->align && s->pos % 4)
+        s->pos += 4 - s->pos % 4;
+}
+
+static int field_selected(VALUE fields, VALUE name) {
+    for (long i = 0; i < RARRAY_LEN(fields); i++)
+        if (rb_str_equal(RARRAY_AREF(fields, i), name) == Qtrue)
+            return 1;
+    return 0;
+}
+
+/*
+ * Parses only the children of the root whose names are in fields
+ * Other children before the last selected one are skipped, and the rest is not read at all.
+ */
+static VALUE parse_fields(ParseState *s, const ObjectParser *p, VALUE klass, VALUE fields) {
+    const ParserOp *op = p->ops;
+    long last = -1;
+    for (long i = 0; i < op->num_children; i++)
+        if (field_selected(fields, p->ops[op->first_child + i].name))
+            last = i;
+    VALUE ret = new_object_value(klass, op, s);
+    VALUE attr = rb_hash_new();
+    for (long i = 0; i <= last; i++) {
+        const ParserOp *child = p->ops + op->first_child + i;
+        if (field_selected(fields, child->name))
+            rb_hash_aset(attr, child->key, parse_node(s, p, child, s->value_class));
+        else
+            skip_node(s, p, child);
+    }
+    rb_ivar_set(ret, id_iv_attr, attr);
+    rb_ivar_set(ret, id_iv_is_struct, Qtrue);
+    return ret;
+}
+
+static LazyStruct *get_lazy_struct(VALUE self, const ObjectParser **p, ParseState *s) {
+    LazyStruct *l;
+    TypedData_Get_Struct(self, LazyStruct, &lazy_struct_type, l);
+    *p = get_object_parser(l->parser);
+    ParseState state = {(const uint8_t *)RSTRING_PTR(l->data), RSTRING_LEN(l->data), l->start,
+                        is_little_endian(l->endian), l->endian, l->asset,
+                        l->value_class, l->parser, l->data, 1, l->packed};
+    *s = state;
+    return l;
+}
+
+// returns the index of the last child with the name (which takes precedence in Hash), or -1
+static long lazy_child_index(const LazyStruct *l, const ObjectParser *p, VALUE name) {
+    const ParserOp *op = p->ops + l->op;
+    for (long i = op->num_children - 1; i >= 0; i--)
+        if (rb_str_equal(p->ops[op->first_child + i].name, name) == Qtrue)
+            return i;
+    return -1;
+}
+
+static long lazy_child_offset(LazyStruct *l, ParseState *s, const ObjectParser *p, long index) {
+    const ParserOp *op = p->ops + l->op;
+    long offset = p->ops[op->first_child + index].offset;
+    if (offset >= 0)
+        return l->start + offset;
+    while (l->num_known < index) {
+        s->pos = l->offsets[l->num_known];
+        skip_node(s, p, p->ops + op->first_child + l->num_known);
+        l->offsets[++l->num_known] = s->pos;
+    }
+    return l->offsets[index];
+}
+
+/*
+ * Names of the children
+ *
+ * @return [Array<String>]
+ */
+static VALUE rb_lazy_struct_keys(VALUE self) {
+    const ObjectParser *p;
+    ParseState s;
+    const LazyStruct *l = get_lazy_struct(self, &p, &s);
+    const ParserOp *op = p->ops + l->op;
+    VALUE ret = rb_ary_new_capa(op->num_children);
+    for (long i = 0; i < op->num_children; i++) {
+        VALUE key = p->ops[op->first_child + i].key;
+        if (!RTEST(rb_ary_includes(ret, key)))
+            rb_ary_push(ret, key);
+    }
+    return ret;
+}
+
+/*
+ * Whether a child with the name exists
+ *
+ * @param [String] rb_name name
+ * @return [Boolean]
+ */
+static VALUE rb_lazy_struct_key_p(VALUE self, VALUE rb_name) {
+    const ObjectParser *p;
+    ParseState s;
+    const LazyStruct *l = get_lazy_struct(self, &p, &s);
+    return lazy_child_index(l, p, rb_name) >= 0 ? Qtrue : Qfalse;
+}
+
+/*
+ * Decodes a child
+ * A child which is a struct is also decoded lazily.
+ *
+ * @param [String] rb_name name
+ * @return [Mikunyan::ObjectValue,nil] child, or nil if there is no child with the name
+ */
+static VALUE rb_lazy_struct_fetch(VALUE self, VALUE rb_name) {
+    const ObjectParser *p;
+    ParseState s;
+    LazyStruct *l = get_lazy_struct(self, &p, &s);
+    long index = lazy_child_index(l, p, rb_name);
+    if (index < 0)
+        return Qnil;
+    const ParserOp *child = p->ops + p->ops[l->op].first_child + index;
+    s.pos = lazy_child_offset(l, &s, p, index);
+    if (child->op == OP_STRUCT)
+        return new_lazy_struct(&s, p, child, s.value_class);
+    VALUE ret = parse_node(&s, p, child, s.value_class);
+    if (l->num_known == index)
+        l->offsets[++l->num_known] = s.pos;
+    return ret;
+}
+
+/*
+ * Decodes all the children which are not in rb_attr
+ * They are decoded entirely (not lazily), and the children in rb_attr are skipped.
+ *
+ * @param [Hash{String=>Mikunyan::ObjectValue}] rb_attr children already decoded
+ * @return [Hash{String=>Mikunyan::ObjectValue}] all the children in order
+ */
+static VALUE rb_lazy_struct_fetch_all(VALUE self, VALUE rb_attr) {
+    const ObjectParser *p;
+    ParseState s;
+    const LazyStruct *l = get_lazy_struct(self, &p, &s);
+    const ParserOp *op = p->ops + l->op;
+    Check_Type(rb_attr, T_HASH);
+    s.lazy = 0;
+    VALUE ret = rb_hash_new();
+    for (long i = 0; i < op->num_children; i++) {
+        const ParserOp *child = p->ops + op->first_child + i;
+        VALUE v = rb_hash_lookup2(rb_attr, child->key, Qundef);
+        if (v == Qundef) {
+            v = parse_node(&s, p, child, s.value_class);
+        } else {
+            skip_node(&s, p, child);
+        }
+        rb_hash_aset(ret, child->key, v);
+    }
+    return ret;
+}
+
+static PackedArray *get_packed_array(VALUE self) {
+    PackedArray *a;
+    TypedData_Get_Struct(self, PackedArray, &packed_array_type, a);
+    return a;
+}
+
+static inline VALUE packed_array_at(const PackedArray *a, long index) {
+    long unit = leaf_sizes[a->op];
+    return leaf_value((const uint8_t *)RSTRING_PTR(a->data) + index * unit, a->op, a->little);
+}
+
+/*
+ * Number of elements
+ *
+ * @return [Integer]
+ */
+static VALUE rb_packed_array_size(VALUE self) {
+    return LONG2NUM(get_packed_array(self)->count);
+}
+
+/*
+ * Element at index
+ *
+ * @param [Integer] rb_index index (negative for the position from the end)
+ * @return [Integer,Float,Boolean,nil] element, or nil if out of range
+ */
+static VALUE rb_packed_array_aref(VALUE self, VALUE rb_index) {
+    const PackedArray *a = get_packed_array(self);
+    long index = NUM2LONG(rb_index);
+    if (index < 0)
+        index += a->count;
+    return index < 0 || index >= a->count ? Qnil : packed_array_at(a, index);
+}
+
+static VALUE packed_array_enum_size(VALUE self, VALUE args, VALUE eobj) {
+    return rb_packed_array_size(self);
+}
+
+/*
+ * Iterates elements
+ *
+ * @yieldparam [Integer,Float,Boolean] value element
+ * @return [self,Enumerator]
+ */
+static VALUE rb_packed_array_each(VALUE self) {
+    RETURN_SIZED_ENUMERATOR(self, 0, 0, packed_array_enum_size);
+    const PackedArray *a = get_packed_array(self);
+    for (long i = 0; i < a->count; i++)
+        rb_yield(packed_array_at(a, i));
+    return self;
+}
+
+/*
+ * Decodes all elements
+ *
+ * @return [Array<Integer,Float,Boolean>]
+ */
+static VALUE rb_packed_array_to_a(VALUE self) {
+    const PackedArray *a = get_packed_array(self);
+    VALUE ret = rb_ary_new_capa(a->count);
+    for (long i = 0; i < a->count; i++)
+        rb_ary_push(ret, packed_array_at(a, i));
+    return ret;
+}
+
+/*
+ * Binary data of elements
+ *
+ * @return [String]
+ */
+static VALUE rb_packed_array_data(VALUE self) {
+    return get_packed_array(self)->data;
+}
+
+/*
+ * Type name of elements
+ *
+ * @return [String]
+ */
+static VALUE rb_packed_array_type(VALUE self) {
+    return get_packed_array(self)->type;
+}
+
+/*
+ * Endianness of data
+ *
+ * @return [Symbol]
+ */
+static VALUE rb_packed_array_endian(VALUE self) {
+    return get_packed_array(self)->endian;
+}
+
+/*
+ * Parse object data into ObjectValue
+ * Blobs of StreamingInfo are read by the private method get_stream_blob of rb_asset.
+ *
+ * If rb_fields is given and the root is a struct, only its children with the names are parsed,
+ * and other children are skipped without being decoded.
+ *
+ * If rb_lazy is true, structs (except in arrays) are parsed into ObjectValue whose children are decoded
+ * when they are accessed (see {Mikunyan::ObjectValue#materialize}).
+ *
+ * If rb_packed is true, arrays of primitives are parsed into {Mikunyan::PackedArray}
+ * instead of Array of ObjectValue.
+ *
+ * @param [String] rb_data object data
+ * @param [Symbol] rb_endian endianness
+ * @param [Class] rb_klass class of the root value (a subclass of ObjectValue)
+ * @param [Mikunyan::Asset,nil] rb_asset asset containing the object
+ * @param [Array<String>,nil] rb_fields names of fields to parse (all if nil)
+ * @param [Boolean] rb_lazy whether structs are decoded lazily
+ * @param [Boolean] rb_packed whether arrays of primitives are kept packed
+ * @return [Mikunyan::ObjectValue] parsed object
+ */
+static VALUE rb_object_parser_parse(int argc, VALUE *argv, VALUE self) {
+    rb_check_arity(argc, 4, 7);
+    const ObjectParser *p = get_object_parser(self);
+    VALUE rb_endian = argv[1], fields = argc > 4 ? argv[4] : Qnil;
+    int lazy = argc > 5 && RTEST(argv[5]), packed = argc > 6 && RTEST(argv[6]);
+    VALUE data = rb_str_new_frozen(StringValue(argv[0]));
+    if (!NIL_P(fields)) {
+        fields = rb_ary_dup(rb_check_array_type(fields));
+        for (long i = 0; i < RARRAY_LEN(fields); i++) {
+            VALUE name = RARRAY_AREF(fields, i);
+            RARRAY_ASET(fields, i, SYMBOL_P(name) ? rb_sym2str(name) : StringValue(name));
+        }
+    }
+    ParseState s = {(const uint8_t *)RSTRING_PTR(data), RSTRING_LEN(data), 0,
+                    is_little_endian(rb_endian), rb_endian, argv[3],
+                    rb_path2class("Mikunyan::ObjectValue"), self, data, lazy, packed};
+    VALUE ret;
+    if (!NIL_P(fields) && p->ops->op == OP_STRUCT)
+        ret = parse_fields(&s, p, argv[2], fields);
+    else if (lazy && p->ops->op == OP_STRUCT)
+        ret = new_lazy_struct(&s, p, p->ops, argv[2]);
+    else
+        ret = parse_node(&s, p, p->ops, argv[2]);
+    RB_GC_GUARD(data);
+    RB_GC_GUARD(fields);
+    return ret;
+}
+
+void Init_object_parser(VALUE mMikunyan) {
+    id_get_stream_blob = rb_intern("get_stream_blob");
+    id_iv_name = rb_intern("@name");
+    id_iv_type = rb_intern("@type");
+    id_iv_endian = rb_intern("@endian");
+    id_iv_value = rb_intern("@value");
+    id_iv_is_struct = rb_intern("@is_struct");
+    id_iv_attr = rb_intern("@attr");
+    str_data = rb_obj_freeze(rb_str_new_cstr("data"));
+    rb_gc_register_mark_object(str_data);
+    VALUE cObjectParser = rb_define_class_under(mMikunyan, "ObjectParser", rb_cObject);
+    rb_define_alloc_func(cObjectParser, rb_object_parser_alloc);
+    rb_define_method(cObjectParser, "initialize", rb_object_parser_initialize, 1);
+    rb_define_method(cObjectParser, "parse", rb_object_parser_parse, -1);
+
+    id_iv_lazy = rb_intern("@lazy");
+    cLazyStruct = rb_define_class_under(cObjectParser, "LazyStruct", rb_cObject);
+    rb_undef_alloc_func(cLazyStruct);
+    rb_define_method(cLazyStruct, "keys", rb_lazy_struct_keys, 0);
+    rb_define_method(cLazyStruct, "key?", rb_lazy_struct_key_p, 1);
+    rb_define_method(cLazyStruct, "fetch", rb_lazy_struct_fetch, 1);
+    rb_define_method(cLazyStruct, "fetch_all", rb_lazy_struct_fetch_all, 1);
+
+    cPackedArray = rb_define_class_under(mMikunyan, "PackedArray", rb_cObject);
+    rb_undef_alloc_func(cPackedArray);
+    rb_include_module(cPackedArray, rb_mEnumerable);
+    rb_define_method(cPackedArray, "size", rb_packed_array_size, 0);
+    rb_define_method(cPackedArray, "[]", rb_packed_array_aref, 1);
+    rb_define_method(cPackedArray, "each", rb_packed_array_each, 0);
+    rb_define_method(cPackedArray, "to_a", rb_packed_array_to_a, 0);
+    rb_define_method(cPackedArray, "data", rb_packed_array_data, 0);
+    rb_define_method(cPackedArray, "type", rb_packed_array_type, 0);
+    rb_define_method(cPackedArray, "endian", rb_packed_array_endian, 0);
+    rb_define_alias(cPackedArray, "length", "size");
+}
@@ -0,0 +1,8 @@
+#ifndef OBJECT_PARSER_H
+#define OBJECT_PARSER_H
+
+#include <ruby.h>
+
+void Init_object_parser(VALUE);
+
+#endif /* end of include guard: OBJECT_PARSER_H */
@@ -0,0 +1,138 @@
+#include "parallel.h"
+#include <stdint.h>
+#include <unistd.h>
+#include "color.h"
+#ifdef HAVE_PTHREAD_H
+#include <pthread.h>
+#endif
+
+#define MAX_DECODER_THREADS 64
+
+// minimum number of blocks decoded by one thread
+#define MIN_BLOCKS_PER_THREAD 1024
+
+extern _Thread_local const char *error_msg;
+
+static int decoder_threads = 1;
+
+int get_decoder_threads(void) {
+    return decoder_threads;
+}
+
+void set_decoder_threads(const int n) {
+    int threads = n;
+#ifdef _SC_NPROCESSORS_ONLN
+    if (threads <= 0)
+        threads = sysconf(_SC_NPROCESSORS_ONLN);
+#endif
+    if (threads <= 0)
+        threads = 1;
+    decoder_threads = threads > MAX_DECODER_THREADS ? MAX_DECODER_THREADS : threads;
+}
+
+typedef struct {
+    ParallelFunc func;
+    void *arg;
+    long begin;
+    long end;
+    int result;
+    const char *error;
+} ParallelTask;
+
+static void run_task(ParallelTask *task) {
+    task->result = task->func(task->arg, task->begin, task->end);
+    if (!task->result) {
+        task->error = error_msg;
+        error_msg = NULL;
+    }
+}
+
+#ifdef HAVE_PTHREAD_H
+static void *run_task_thread(void *ptr) {
+    run_task((ParallelTask *)ptr);
+    return NULL;
+}
+#endif
+
+/*
+ * Calls func(arg, begin, end) over [0, n) split into contiguous ranges, one per decoder thread
+ * Each range contains at least `grain` items; the first range runs on the calling thread.
+ * Returns 0 and sets error_msg if any of the calls fails.
+ */
+int parallel_for(const long n, const long grain, ParallelFunc func, void *arg) {
+    long num_tasks = decoder_threads;
+    if (grain > 0 && n / grain < num_tasks)
+        num_tasks = n / grain;
+    if (n < num_tasks)
+        num_tasks = n;
+#ifdef HAVE_PTHREAD_H
+    long chunk = num_tasks > 1 ? (n + num_tasks - 1) / num_tasks : n;
+    // rounding chunk up can leave trailing tasks without items (e.g. 5 items in 4 tasks of 2)
+    if (num_tasks > 1)
+        num_tasks = (n + chunk - 1) / chunk;
+    if (num_tasks > 1) {
+        ParallelTask tasks[MAX_DECODER_THREADS];
+        pthread_t threads[MAX_DECODER_THREADS];
+        int started[MAX_DECODER_THREADS] = {0};
+        for (long i = 0; i < num_tasks; i++) {
+            long begin = chunk * i;
+            tasks[i] = (ParallelTask){func, arg, begin, begin + chunk < n ? begin + chunk : n, 0, NULL};
+        }
+        for (long i = 1; i < num_tasks; i++)
+            started[i] = pthread_create(&threads[i], NULL, run_task_thread, &tasks[i]) == 0;
+        run_task(&tasks[0]);
+        for (long i = 1; i < num_tasks; i++) {
+            if (started[i])
+                pthread_join(threads[i], NULL);
+            else
+                run_task(&tasks[i]);
+        }
+        for (long i = 0; i < num_tasks; i++) {
+            if (!tasks[i].result) {
+                error_msg = tasks[i].error;
+                return 0;
+            }
+        }
+        return 1;
+    }
+#endif
+    return func(arg, 0, n);
+}
+
+typedef struct {
+    const uint8_t *data;
+    long w;
+    long h;
+    int bw;
+    int bh;
+    long block_size;
+    long num_blocks_x;
+    BlockDecodeFunc func;
+    uint32_t *image;
+} BlockDecodeJob;
+
+static int decode_block_rows(void *arg, const long by_begin, const long by_end) {
+    const BlockDecodeJob *job = (const BlockDecodeJob *)arg;
+    uint32_t buffer[144];
+    const uint8_t *d = job->data + by_begin * job->num_blocks_x * job->block_size;
+    for (long by = by_begin; by < by_end; by++) {
+        for (long bx = 0; bx < job->num_blocks_x; bx++, d += job->block_size) {
+            job->func(d, buffer);
+            copy_block_buffer(bx, by, job->w, job->h, job->bw, job->bh, buffer, job->image);
+        }
+    }
+    return 1;
+}
+
+/*
+ * Decodes a block-compressed image with block rows distributed over decoder threads
+ * func decodes one block of block_size bytes into bw * bh pixels (at most 144).
+ */
+int decode_blocks(const uint8_t *data, const long w, const long h, const int bw, const int bh, const long block_size,
+                  BlockDecodeFunc func, uint32_t *image) {
+    long num_blocks_x = (w + bw - 1) / bw;
+    long num_blocks_y = (h + bh - 1) / bh;
+    BlockDecodeJob job = {data, w, h, bw, bh, block_size, num_blocks_x, func, image};
+    long grain = num_blocks_x > 0 ? (MIN_BLOCKS_PER_THREAD + num_blocks_x - 1) / num_blocks_x : 1;
+    return parallel_for(num_blocks_y, grain, decode_block_rows, &job);
+}
@@ -0,0 +1,15 @@
+#ifndef PARALLEL_H
+#define PARALLEL_H
+
+#include <stdint.h>
+
+typedef int (*ParallelFunc)(void *, const long, const long);
+typedef void (*BlockDecodeFunc)(const uint8_t *, uint32_t *);
+
+int get_decoder_threads(void);
+void set_decoder_threads(const int);
+int parallel_for(const long, const long, ParallelFunc, void *);
+int decode_blocks(const uint8_t *, const long, const long, const int, const int, const long, BlockDecodeFunc,
+                  uint32_t *);
+
+#endif /* end of include guard: PARALLEL_H */
@@ -0,0 +1,309 @@
+#include "png.h"
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <zlib.h>
+#include "parallel.h"
+
+// minimum number of bytes filtered by one thread
+#define MIN_FILTER_BYTES (64 * 1024)
+
+// minimum number of bytes deflated by one thread
+#define MIN_DEFLATE_BYTES (256 * 1024)
+
+// largest piece of input passed to zlib at once (zlib counts bytes in uInt)
+#define MAX_ZLIB_PIECE (1L << 30)
+
+#define DEFLATE_WINDOW_SIZE 32768
+
+extern _Thread_local const char *error_msg;
+
+static inline uint8_t paeth(const uint8_t a, const uint8_t b, const uint8_t c) {
+    int p = a + b - c, pa = abs(p - a), pb = abs(p - b), pc = abs(p - c);
+    return pa <= pb && pa <= pc ? a : pb <= pc ? b : c;
+}
+
+static void filter_row(const int type, const uint8_t *row, const uint8_t *prev, const long len, const int bpp,
+                       uint8_t *out) {
+    long i;
+    switch (type) {
+    case PNG_FILTER_SUB:
+        for (i = 0; i < bpp; i++)
+            out[i] = row[i];
+        for (; i < len; i++)
+            out[i] = row[i] - row[i - bpp];
+        break;
+    case PNG_FILTER_UP:
+        for (i = 0; i < len; i++)
+            out[i] = row[i] - prev[i];
+        break;
+    case PNG_FILTER_AVERAGE:
+        for (i = 0; i < bpp; i++)
+            out[i] = row[i] - (prev[i] >> 1);
+        for (; i < len; i++)
+            out[i] = row[i] - ((row[i - bpp] + prev[i]) >> 1);
+        break;
+    case PNG_FILTER_PAETH:
+        for (i = 0; i < bpp; i++)
+            out[i] = row[i] - prev[i];
+        for (; i < len; i++)
+            out[i] = row[i] - paeth(row[i - bpp], prev[i], prev[i - bpp]);
+        break;
+    default:
+        memcpy(out, row, len);
+    }
+}
+
+// sum of the filtered bytes as signed values, the heuristic recommended by the PNG specification
+static unsigned long filter_score(const uint8_t *out, const long len) {
+    unsigned long score = 0;
+    for (long i = 0; i < len; i++)
+        score += abs((int8_t)out[i]);
+    return score;
+}
+
+typedef struct {
+    const uint8_t *pixels;
+    long stride;
+    int bpp;
+    int filter;
+    const uint8_t *zero_row;
+    uint8_t *filtered;
+} FilterJob;
+
+static int filter_rows(void *arg, const long y_begin, const long y_end) {
+    const FilterJob *job = (const FilterJob *)arg;
+    const long stride = job->stride;
+    uint8_t *buffer = NULL, *trial = NULL, *best = NULL;
+    if (job->filter == PNG_FILTER_ADAPTIVE) {
+        buffer = malloc(stride * 2);
+        if (!buffer) {
+            error_msg = "memory allocation failed";
+            return 0;
+        }
+        trial = buffer;
+        best = buffer + stride;
+    }
+    for (long y = y_begin; y < y_end; y++) {
+        const uint8_t *row = job->pixels + y * stride;
+        const uint8_t *prev = y > 0 ? row - stride : job->zero_row;
+        uint8_t *out = job->filtered + y * (stride + 1);
+        if (job->filter != PNG_FILTER_ADAPTIVE) {
+            out[0] = job->filter;
+            filter_row(job->filter, row, prev, stride, job->bpp, out + 1);
+            continue;
+        }
+        unsigned long best_score = ~0UL;
+        for (int type = PNG_FILTER_NONE; type <= PNG_FILTER_PAETH; type++) {
+            filter_row(type, row, prev, stride, job->bpp, trial);
+            unsigned long score = filter_score(trial, stride);
+            if (score < best_score) {
+                uint8_t *t = best;
+                best = trial;
+                trial = t;
+                best_score = score;
+                out[0] = type;
+            }
+        }
+        memcpy(out + 1, best, stride);
+    }
+    free(buffer);
+    return 1;
+}
+
+typedef struct {
+    uint8_t *out;
+    long out_len;
+    uLong adler;
+} DeflateChunk;
+
+typedef struct {
+    const uint8_t *data;
+    long size;
+    long num_chunks;
+    int level;
+    int strategy;
+    DeflateChunk *chunks;
+} DeflateJob;
+
+/*
+ * Deflates one chunk of the filtered data as a part of a single raw deflate stream
+ * All chunks but the last end with a sync flush, so that they can be concatenated.
+ * The preceding window is set as the dictionary so that the compression ratio is barely affected.
+ */
+static int deflate_chunk(const DeflateJob *job, const long i) {
+    const long begin = job->size * i / job->num_chunks, end = job->size * (i + 1) / job->num_chunks;
+    const int last = i == job->num_chunks - 1;
+    DeflateChunk *chunk = job->chunks + i;
+    z_stream z;
+    memset(&z, 0, sizeof(z));
+    if (deflateInit2(&z, job->level, Z_DEFLATED, -15, 8, job->strategy) != Z_OK) {
+        error_msg = "zlib initialization failed";
+        return 0;
+    }
+    if (begin > 0) {
+        long dict_len = begin < DEFLATE_WINDOW_SIZE ? begin : DEFLATE_WINDOW_SIZE;
+        deflateSetDictionary(&z, job->data + begin - dict_len, dict_len);
+    }
+    // a sync flush appends an empty stored block of 5 bytes at most
+    const uLong capacity = deflateBound(&z, end - begin) + 16;
+    chunk->out = malloc(capacity);
+    if (!chunk->out) {
+        deflateEnd(&z);
+        error_msg = "memory allocation failed";
+        return 0;
+    }
+    chunk->adler = adler32(0, NULL, 0);
+    z.next_out = chunk->out;
+    const uint8_t *in = job->data + begin;
+    long left = end - begin;
+    int ret;
+    do {
+        const long n = left < MAX_ZLIB_PIECE ? left : MAX_ZLIB_PIECE;
+        chunk->adler = adler32(chunk->adler, in, n);
+        z.next_in = (Bytef *)in;
+        z.avail_in = n;
+        in += n;
+        left -= n;
+        const int flush = left > 0 ? Z_NO_FLUSH : last ? Z_FINISH : Z_SYNC_FLUSH;
+        // output space is also given piece by piece, so the piece may not be consumed at once
+        do {
+            const uLong avail_out = capacity - (z.next_out - chunk->out);
+            z.avail_out = avail_out < MAX_ZLIB_PIECE * 2 ? avail_out : MAX_ZLIB_PIECE * 2;
+            ret = deflate(&z, flush);
+        } while (ret == Z_OK && (z.avail_in || flush == Z_FINISH || (flush == Z_SYNC_FLUSH && !z.avail_out)));
+    } while (left > 0 && ret == Z_OK);
+    chunk->out_len = z.next_out - chunk->out;
+    deflateEnd(&z);
+    if (ret != (last ? Z_STREAM_END : Z_OK) || z.avail_in) {
+        error_msg = "deflating image data failed";
+        return 0;
+    }
+    return 1;
+}
+
+static int deflate_chunks(void *arg, const long begin, const long end) {
+    for (long i = begin; i < end; i++)
+        if (!deflate_chunk((const DeflateJob *)arg, i))
+            return 0;
+    return 1;
+}
+
+static inline uint8_t *put_u32be(uint8_t *p, const uint32_t v) {
+    p[0] = v >> 24;
+    p[1] = v >> 16;
+    p[2] = v >> 8;
+    p[3] = v;
+    return p + 4;
+}
+
+// writes the CRC of the chunk whose type starts at p and returns the end of the chunk
+static uint8_t *put_crc(uint8_t *p, const long len) {
+    uLong crc = crc32(0, NULL, 0);
+    for (long i = 0; i < len + 4; i += MAX_ZLIB_PIECE) {
+        long n = len + 4 - i < MAX_ZLIB_PIECE ? len + 4 - i : MAX_ZLIB_PIECE;
+        crc = crc32(crc, p + i, n);
+    }
+    return put_u32be(p + len + 4, crc);
+}
+
+static int write_png(const long w, const long h, const int channels, const int level, const DeflateJob *job,
+                     uint8_t **png, long *png_len) {
+    long idat_len = 2 + 4;
+    uLong adler = adler32(0, NULL, 0);
+    for (long i = 0; i < job->num_chunks; i++) {
+        const DeflateChunk *chunk = job->chunks + i;
+        const long begin = job->size * i / job->num_chunks, end = job->size * (i + 1) / job->num_chunks;
+        idat_len += chunk->out_len;
+        adler = i == 0 ? chunk->adler : adler32_combine(adler, chunk->adler, end - begin);
+    }
+    if (idat_len > 0x7fffffffL) {
+        error_msg = "image is too large to encode";
+        return 0;
+    }
+    *png_len = 8 + (12 + 13) + (12 + idat_len) + 12;
+    uint8_t *p = *png = malloc(*png_len);
+    if (!p) {
+        error_msg = "memory allocation failed";
+        return 0;
+    }
+
+    static const uint8_t signature[8] = {0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n'};
+    memcpy(p, signature, 8);
+    p += 8;
+
+    p = put_u32be(p, 13);
+    memcpy(p, "IHDR", 4);
+    put_u32be(p + 4, w);
+    put_u32be(p + 8, h);
+    p[12] = 8;
+    p[13] = channels == 4 ? 6 : 2;
+    p[14] = p[15] = p[16] = 0;
+    p = put_crc(p, 13);
+
+    p = put_u32be(p, idat_len);
+    memcpy(p, "IDAT", 4);
+    uint8_t *d = p + 4;
+    // zlib header with the compression level hint
+    const int flevel = level < 0 || level == 6 ? 2 : level < 2 ? 0 : level < 6 ? 1 : 3;
+    d[0] = 0x78;
+    d[1] = flevel << 6;
+    d[1] += 31 - (d[0] * 256 + d[1]) % 31;
+    d += 2;
+    for (long i = 0; i < job->num_chunks; i++) {
+        memcpy(d, job->chunks[i].out, job->chunks[i].out_len);
+        d += job->chunks[i].out_len;
+    }
+    put_u32be(d, adler);
+    p = put_crc(p, idat_len);
+
+    p = put_u32be(p, 0);
+    memcpy(p, "IEND", 4);
+    put_crc(p, 0);
+    return 1;
+}
+
+/*
+ * Encodes 8-bit RGB or RGBA pixels (top row first) to PNG
+ * filter is one of PNG_FILTER_*, and level is a zlib compression level (-1 for the default).
+ * Rows are filtered and deflated in chunks on decoder threads. The result is allocated with malloc.
+ */
+int encode_png(const uint8_t *pixels, const long w, const long h, const int channels, const int level,
+               const int filter, uint8_t **png, long *png_len) {
+    const long stride = w * channels, size = (stride + 1) * h;
+    uint8_t *filtered = malloc(size);
+    uint8_t *zero_row = calloc(stride, 1);
+    if (!filtered || !zero_row) {
+        free(filtered);
+        free(zero_row);
+        error_msg = "memory allocation failed";
+        return 0;
+    }
+    FilterJob filter_job = {pixels, stride, channels, filter, zero_row, filtered};
+    int ok = parallel_for(h, (MIN_FILTER_BYTES + stride) / (stride + 1), filter_rows, &filter_job);
+    free(zero_row);
+
+    long num_chunks = get_decoder_threads();
+    if (size / MIN_DEFLATE_BYTES < num_chunks)
+        num_chunks = size / MIN_DEFLATE_BYTES;
+    if (num_chunks < 1)
+        num_chunks = 1;
+    DeflateChunk *chunks = calloc(num_chunks, sizeof(DeflateChunk));
+    if (ok && !chunks) {
+        error_msg = "memory allocation failed";
+        ok = 0;
+    }
+    // filtered rows consist of small values which are better coded by Huffman than by short matches, as in libpng
+    const int strategy = filter == PNG_FILTER_NONE ? Z_DEFAULT_STRATEGY : Z_FILTERED;
+    DeflateJob deflate_job = {filtered, size, num_chunks, level, strategy, chunks};
+    if (ok)
+        ok = parallel_for(num_chunks, 1, deflate_chunks, &deflate_job);
+    free(filtered);
+    if (ok)
+        ok = write_png(w, h, channels, level, &deflate_job, png, png_len);
+    if (chunks)
+        for (long i = 0; i < num_chunks; i++)
+            free(chunks[i].out);
+    free(chunks);
+    return ok;
+}
@@ -0,0 +1,17 @@
+#ifndef PNG_H
+#define PNG_H
+
+#include <stdint.h>
+
+#define PNG_FILTER_NONE 0
+#define PNG_FILTER_SUB 1
+#define PNG_FILTER_UP 2
+#define PNG_FILTER_AVERAGE 3
+#define PNG_FILTER_PAETH 4
+#define PNG_FILTER_ADAPTIVE 5
+
+#define PNG_LEVEL_DEFAULT (-1)
+
+int encode_png(const uint8_t *, const long, const long, const int, const int, const int, uint8_t **, long *);
+
+#endif /* end of include guard: PNG_H */
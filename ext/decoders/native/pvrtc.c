@@ -210,14 +210,14 @@ int decode_pvrtc(const uint8_t *data, const long w, const long h, uint32_t *imag
     long min_num_blocks = num_blocks_x <= num_blocks_y ? num_blocks_x : num_blocks_y;
 
     if ((num_blocks_x & (num_blocks_x - 1)) || (num_blocks_y & (num_blocks_y - 1))) {
-        extern const char *error_msg;
+        extern _Thread_local const char *error_msg;
         error_msg = "the number of blocks of each side must be a power of 2";
         return 0;
     }
 
     PVRTCTexelInfo *texel_info = (PVRTCTexelInfo *)malloc(sizeof(PVRTCTexelInfo) * num_blocks);
     if (texel_info == NULL) {
-        extern const char *error_msg;
+        extern _Thread_local const char *error_msg;
         error_msg = "memory allocation failed";
         return 0;
     }
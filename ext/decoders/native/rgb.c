@@ -1,8 +1,12 @@
 #include "rgb.h"
 #include <math.h>
 #include <stdint.h>
+#include <string.h>
 #include "color.h"
 #include "fp16.h"
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
 
 int decode_a8(const uint8_t *const data, const long size, uint8_t *image) {
     const uint8_t *d = data, *d_end = data + size;
@@ -75,13 +79,13 @@ int decode_rhalf(const uint16_t *data, const long size, const int endian_big, ui
 
 int decode_rghalf(const uint16_t *data, const long size, const int endian_big, uint8_t *image) {
     if (endian_big) {
-        for (long i = 0; i < size; i++, data++, image++) {
+        for (long i = 0; i < size; i++) {
             *image++ = u16_f16_u8(bton16(*data++));
             *image++ = u16_f16_u8(bton16(*data++));
             *image++ = 0;
         }
     } else {
-        for (long i = 0; i < size; i++, data++) {
+        for (long i = 0; i < size; i++) {
             *image++ = u16_f16_u8(lton16(*data++));
             *image++ = u16_f16_u8(lton16(*data++));
             *image++ = 0;
@@ -100,3 +104,203 @@ int decode_rgbahalf(const uint16_t *data, const long size, const int endian_big,
             *image = u16_f16_u8(lton16(*data));
     return 1;
 }
+
+/*
+ * The decoders below take the image size and write rows bottom-up,
+ * so that the output is flipped vertically without a separate pass.
+ */
+
+int decode_argb32(const uint8_t *data, const long w, const long h, uint8_t *image) {
+    for (long y = h - 1; y >= 0; y--) {
+        uint8_t *p = image + y * w * 4;
+        for (long x = 0; x < w; x++, data += 4, p += 4) {
+            p[0] = data[1];
+            p[1] = data[2];
+            p[2] = data[3];
+            p[3] = data[0];
+        }
+    }
+    return 1;
+}
+
+int decode_bgra32(const uint8_t *data, const long w, const long h, uint8_t *image) {
+    for (long y = h - 1; y >= 0; y--) {
+        uint8_t *p = image + y * w * 4;
+        for (long x = 0; x < w; x++, data += 4, p += 4) {
+            p[0] = data[2];
+            p[1] = data[1];
+            p[2] = data[0];
+            p[3] = data[3];
+        }
+    }
+    return 1;
+}
+
+static inline uint8_t expand4(const uint8_t v) {
+    return (v & 0xf) * 0x11;
+}
+
+int decode_argb4444(const uint8_t *data, const long w, const long h, const int endian_big, uint8_t *image) {
+    const int hi = endian_big ? 0 : 1, lo = 1 - hi;
+    for (long y = h - 1; y >= 0; y--) {
+        uint8_t *p = image + y * w * 4;
+        for (long x = 0; x < w; x++, data += 2, p += 4) {
+            p[0] = expand4(data[hi]);
+            p[1] = expand4(data[lo] >> 4);
+            p[2] = expand4(data[lo]);
+            p[3] = expand4(data[hi] >> 4);
+        }
+    }
+    return 1;
+}
+
+int decode_rgba4444(const uint8_t *data, const long w, const long h, const int endian_big, uint8_t *image) {
+    const int hi = endian_big ? 0 : 1, lo = 1 - hi;
+    for (long y = h - 1; y >= 0; y--) {
+        uint8_t *p = image + y * w * 4;
+        for (long x = 0; x < w; x++, data += 2, p += 4) {
+            p[0] = expand4(data[hi] >> 4);
+            p[1] = expand4(data[hi]);
+            p[2] = expand4(data[lo] >> 4);
+            p[3] = expand4(data[lo]);
+        }
+    }
+    return 1;
+}
+
+int decode_rg16(const uint8_t *data, const long w, const long h, uint8_t *image) {
+    for (long y = h - 1; y >= 0; y--) {
+        uint8_t *p = image + y * w * 3;
+        for (long x = 0; x < w; x++, data += 2, p += 3) {
+            p[0] = data[0];
+            p[1] = data[1];
+            p[2] = 0;
+        }
+    }
+    return 1;
+}
+
+/*
+ * Converts a 32-bit float given as its bit pattern to 8 bits.
+ * Negative and non-finite values become 0, and values not less than 1 become 255.
+ * The product is computed in double so that it is exact and rounds half up.
+ */
+static inline uint8_t f32_u8(const uint32_t u) {
+    if (u >= 0x7f800000)
+        return 0;
+    if (u >= 0x3f800000)
+        return 255;
+    float f;
+    memcpy(&f, &u, 4);
+    return (uint8_t)(f * 255.0 + 0.5);
+}
+
+#ifdef __SSE2__
+/* Same as f32_u8 for 4 values at once. The comparisons are made on the bit patterns. */
+static inline __m128i f32_u8_sse2(const __m128i u) {
+    const __m128i pos = _mm_cmpgt_epi32(u, _mm_set1_epi32(-1));
+    const __m128i lt1 = _mm_and_si128(pos, _mm_cmplt_epi32(u, _mm_set1_epi32(0x3f800000)));
+    const __m128i fin = _mm_and_si128(pos, _mm_cmplt_epi32(u, _mm_set1_epi32(0x7f800000)));
+    const __m128 f = _mm_castsi128_ps(_mm_and_si128(u, lt1));
+    const __m128d k = _mm_set1_pd(255.0), half = _mm_set1_pd(0.5);
+    const __m128i lo = _mm_cvttpd_epi32(_mm_add_pd(_mm_mul_pd(_mm_cvtps_pd(f), k), half));
+    const __m128i hi = _mm_cvttpd_epi32(_mm_add_pd(_mm_mul_pd(_mm_cvtps_pd(_mm_movehl_ps(f, f)), k), half));
+    const __m128i v = _mm_and_si128(_mm_unpacklo_epi64(lo, hi), lt1);
+    return _mm_or_si128(v, _mm_andnot_si128(lt1, _mm_and_si128(fin, _mm_set1_epi32(255))));
+}
+
+static inline __m128i bswap32_sse2(__m128i u) {
+    u = _mm_or_si128(_mm_slli_epi16(u, 8), _mm_srli_epi16(u, 8));
+    return _mm_shufflehi_epi16(_mm_shufflelo_epi16(u, 0xb1), 0xb1);
+}
+#endif
+
+/* Converts n floats to n bytes. */
+static void convert_f32_u8(const uint8_t *data, const long n, const int endian_big, uint8_t *out) {
+    long i = 0;
+#ifdef __SSE2__
+    /* x86 is little endian, so only big endian input needs swapping. */
+    for (; i + 8 <= n; i += 8, data += 32) {
+        __m128i a = _mm_loadu_si128((const __m128i *)data);
+        __m128i b = _mm_loadu_si128((const __m128i *)(data + 16));
+        if (endian_big) {
+            a = bswap32_sse2(a);
+            b = bswap32_sse2(b);
+        }
+        const __m128i v = _mm_packs_epi32(f32_u8_sse2(a), f32_u8_sse2(b));
+        _mm_storel_epi64((__m128i *)(out + i), _mm_packus_epi16(v, v));
+    }
+#endif
+    for (; i < n; i++, data += 4) {
+        uint32_t u;
+        memcpy(&u, data, 4);
+        out[i] = f32_u8(endian_big ? bton32(u) : lton32(u));
+    }
+}
+
+/*
+ * RFloat and RGFloat are converted into the head of each output row first,
+ * and then spread to RGB from the tail so that no value is overwritten before it is read.
+ */
+
+int decode_rfloat(const uint8_t *data, const long w, const long h, const int endian_big, uint8_t *image) {
+    for (long y = h - 1; y >= 0; y--, data += w * 4) {
+        uint8_t *p = image + y * w * 3;
+        convert_f32_u8(data, w, endian_big, p);
+        for (long x = w - 1; x >= 0; x--)
+            p[x * 3] = p[x * 3 + 1] = p[x * 3 + 2] = p[x];
+    }
+    return 1;
+}
+
+int decode_rgfloat(const uint8_t *data, const long w, const long h, const int endian_big, uint8_t *image) {
+    for (long y = h - 1; y >= 0; y--, data += w * 8) {
+        uint8_t *p = image + y * w * 3;
+        convert_f32_u8(data, w * 2, endian_big, p);
+        for (long x = w - 1; x >= 0; x--) {
+            const uint8_t r = p[x * 2], g = p[x * 2 + 1];
+            p[x * 3] = r;
+            p[x * 3 + 1] = g;
+            p[x * 3 + 2] = 0;
+        }
+    }
+    return 1;
+}
+
+int decode_rgbafloat(const uint8_t *data, const long w, const long h, const int endian_big, uint8_t *image) {
+    for (long y = h - 1; y >= 0; y--, data += w * 16)
+        convert_f32_u8(data, w * 4, endian_big, image + y * w * 4);
+    return 1;
+}
+
+/*
+ * Each channel of RGB9e5 is a 9-bit mantissa scaled by 2^(e - 24), where e is
+ * the shared 5-bit exponent. The scaled value times 255 is exact in double.
+ */
+static inline uint8_t rgb9e5_u8(const uint32_t m, const int e) {
+    double v = ldexp(m * 255.0, e - 24);
+    return v < 255 ? (uint8_t)(v + 0.5) : 255;
+}
+
+int decode_rgb9e5float(const uint8_t *data, const long w, const long h, const int endian_big, uint8_t *image) {
+    for (long y = h - 1; y >= 0; y--) {
+        uint8_t *p = image + y * w * 3;
+        for (long x = 0; x < w; x++, data += 4, p += 3) {
+            uint32_t n;
+            memcpy(&n, data, 4);
+            n = endian_big ? bton32(n) : lton32(n);
+            const int e = n >> 27;
+            p[0] = rgb9e5_u8(n & 0x1ff, e);
+            p[1] = rgb9e5_u8(n >> 9 & 0x1ff, e);
+            p[2] = rgb9e5_u8(n >> 18 & 0x1ff, e);
+        }
+    }
+    return 1;
+}
+
+int flip_image(const uint8_t *data, const long w, const long h, const int bpp, uint8_t *image) {
+    const long stride = w * bpp;
+    for (long y = h - 1; y >= 0; y--, data += stride)
+        memcpy(image + y * stride, data, stride);
+    return 1;
+}
@@ -10,5 +10,15 @@ int decode_rgb565(const uint16_t *const, const long, const int, uint8_t *);
 int decode_rhalf(const uint16_t *const, const long, const int, uint8_t *);
 int decode_rghalf(const uint16_t *const, const long, const int, uint8_t *);
 int decode_rgbahalf(const uint16_t *const, const long, const int, uint8_t *);
+int decode_argb32(const uint8_t *, const long, const long, uint8_t *);
+int decode_bgra32(const uint8_t *, const long, const long, uint8_t *);
+int decode_argb4444(const uint8_t *, const long, const long, const int, uint8_t *);
+int decode_rgba4444(const uint8_t *, const long, const long, const int, uint8_t *);
+int decode_rg16(const uint8_t *, const long, const long, uint8_t *);
+int decode_rfloat(const uint8_t *, const long, const long, const int, uint8_t *);
+int decode_rgfloat(const uint8_t *, const long, const long, const int, uint8_t *);
+int decode_rgbafloat(const uint8_t *, const long, const long, const int, uint8_t *);
+int decode_rgb9e5float(const uint8_t *, const long, const long, const int, uint8_t *);
+int flip_image(const uint8_t *, const long, const long, const int, uint8_t *);
 
 #endif /* end of include guard: RGB_H */
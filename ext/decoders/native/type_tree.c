@@ -0,0 +1,327 @@
+#include "type_tree.h"
+#include <ruby/encoding.h>
+#include <stdlib.h>
+#include <string.h>
+#include "binary_reader.h"
+
+static ID id_children, id_flags, id_is_array, id_size, id_type, id_name;
+static VALUE cNodeArray;
+
+static void node_array_mark(void *ptr) {
+    const NodeArray *a = (const NodeArray *)ptr;
+    for (long i = 0; i < a->count; i++) {
+        rb_gc_mark(a->nodes[i].type);
+        rb_gc_mark(a->nodes[i].name);
+    }
+}
+
+static void node_array_free(void *ptr) {
+    xfree(((NodeArray *)ptr)->nodes);
+    xfree(ptr);
+}
+
+static size_t node_array_size(const void *ptr) {
+    return sizeof(NodeArray) + ((const NodeArray *)ptr)->count * sizeof(TreeNode);
+}
+
+static const rb_data_type_t node_array_type = {
+    "Mikunyan::TypeTree::NodeArray",
+    {node_array_mark, node_array_free, node_array_size},
+    NULL,
+    NULL,
+    RUBY_TYPED_FREE_IMMEDIATELY,
+};
+
+// nodes are zero-filled, so the array can be marked while they are being set
+static VALUE new_node_array(long count, NodeArray **a) {
+    VALUE ret = TypedData_Make_Struct(cNodeArray, NodeArray, &node_array_type, *a);
+    (*a)->nodes = ZALLOC_N(TreeNode, count);
+    (*a)->count = count;
+    return ret;
+}
+
+NodeArray *get_node_array(VALUE self) {
+    NodeArray *a;
+    TypedData_Get_Struct(self, NodeArray, &node_array_type, a);
+    return a;
+}
+
+/*
+ * Appends the nodes of the tree under node in preorder
+ * Only the fields used by parsers are read.
+ */
+static void node_array_append_tree(NodeArray *a, long *capa, VALUE node, long level) {
+    if (level > UINT8_MAX)
+        rb_raise(rb_eArgError, "TypeTree is too deep.");
+    if (a->count == *capa) {
+        REALLOC_N(a->nodes, TreeNode, *capa * 2);
+        memset(a->nodes + *capa, 0, *capa * sizeof(TreeNode));
+        *capa *= 2;
+    }
+    TreeNode *n = a->nodes + a->count;
+    n->type = rb_funcall(node, id_type, 0);
+    n->name = rb_funcall(node, id_name, 0);
+    n->size = NUM2LONG(rb_funcall(node, id_size, 0));
+    n->flags = (uint32_t)NUM2LONG(rb_funcall(node, id_flags, 0));
+    n->is_array = RTEST(rb_funcall(node, id_is_array, 0));
+    n->level = (uint8_t)level;
+    a->count++;
+    VALUE children = rb_funcall(node, id_children, 0);
+    Check_Type(children, T_ARRAY);
+    for (long i = 0; i < RARRAY_LEN(children); i++)
+        node_array_append_tree(a, capa, RARRAY_AREF(children, i), level + 1);
+}
+
+/*
+ * Returns rb_node if it is Mikunyan::TypeTree::NodeArray, or the nodes of the tree under Mikunyan::TypeTree::Node
+ */
+VALUE to_node_array(VALUE rb_node) {
+    if (rb_typeddata_is_kind_of(rb_node, &node_array_type))
+        return rb_node;
+    NodeArray *a;
+    long capa = 64;
+    VALUE ret = new_node_array(capa, &a);
+    a->count = 0;
+    node_array_append_tree(a, &capa, rb_node, 0);
+    return ret;
+}
+
+// members of Mikunyan::TypeTree::Node in order
+enum {
+    NODE_VERSION,
+    NODE_LEVEL,
+    NODE_ARRAY,
+    NODE_TYPE,
+    NODE_NAME,
+    NODE_SIZE,
+    NODE_INDEX,
+    NODE_FLAGS,
+    NODE_V18META,
+    NODE_PARENT,
+    NODE_CHILDREN
+};
+
+// node of the bundled TypeTrees (offsets in the string table, or DB_NO_STRING for nil)
+typedef struct {
+    uint32_t type;
+    uint32_t name;
+    int32_t size;
+    uint32_t flags;
+    uint64_t v18meta;
+    uint16_t version;
+    uint8_t level;
+    uint8_t is_array;
+    uint8_t has_v18meta;
+} DbNode;
+
+// bundled TypeTree, sorted by class ID and hash
+typedef struct {
+    int32_t class_id;
+    uint8_t hash[16];
+    uint32_t first;
+    uint32_t count;
+} DbTree;
+
+#define DB_NO_STRING 0xffffffff
+
+// db_strings, db_nodes and db_trees generated from lib/mikunyan/typetrees by extconf.rb
+#include "typetree_db.h"
+
+static ID id_string_table, id_uminus;
+
+/*
+ * Returns the interned string of s
+ * Strings are interned in UTF-8 as literals, so they are shared with the same literals in Mikunyan::Constants.
+ */
+static VALUE intern_string(const char *s, long len) {
+#ifdef HAVE_RB_ENC_INTERNED_STR
+    return rb_enc_interned_str(s, len, rb_utf8_encoding());
+#else
+    return rb_funcall(rb_enc_str_new(s, len, rb_utf8_encoding()), id_uminus, 0);
+#endif
+}
+
+// Returns a string in the string buffer of TypeTree, or in the common string table if the high bit is set
+static VALUE type_tree_string(uint32_t pos, const char *buffer, long buffer_size, VALUE table) {
+    if (pos & 0x80000000)
+        return rb_hash_lookup(table, UINT2NUM(pos & 0x7fffffff));
+    if (pos > buffer_size)
+        rb_raise(rb_eArgError, "String offset out of range.");
+    const char *end = memchr(buffer + pos, 0, buffer_size - pos);
+    return intern_string(buffer + pos, end ? end - (buffer + pos) : buffer_size - pos);
+}
+
+/*
+ * Reads nodes of TypeTree in the blob format (asset format 10 and >= 12) up to the string buffer
+ * Type and name strings are interned.
+ *
+ * @param [Mikunyan::BinaryReader] rb_reader reader
+ * @param [Integer] rb_version asset format version
+ * @return [Mikunyan::TypeTree::NodeArray] nodes
+ */
+static VALUE rb_type_tree_load_nodes(VALUE self, VALUE rb_reader, VALUE rb_version) {
+    BinaryReader *r = get_binary_reader(rb_reader);
+    int version = NUM2INT(rb_version);
+    VALUE table = rb_const_get(rb_path2class("Mikunyan::Constants"), id_string_table);
+    long count = reader_u32(r), buffer_size = reader_u32(r);
+    long entry_size = version >= 18 ? 32 : 24;
+    if (count > LONG_MAX / entry_size)
+        rb_raise(rb_eEOFError, "End of data reached.");
+
+    // the string buffer follows the nodes
+    long nodes_pos = r->pos;
+    reader_advance(r, count * entry_size);
+    const char *buffer = (const char *)reader_advance(r, buffer_size);
+    long end_pos = r->pos;
+    r->pos = nodes_pos;
+
+    NodeArray *a;
+    VALUE ret = new_node_array(count, &a);
+    // each node needs its parent, the last node one level shallower
+    char has_level[256] = {0};
+    for (long i = 0; i < count; i++) {
+        TreeNode *n = a->nodes + i;
+        n->version = reader_u16(r);
+        n->level = *reader_advance(r, 1);
+        n->is_array = *reader_advance(r, 1) != 0;
+        if (n->level > 0 && !has_level[n->level - 1])
+            rb_raise(rb_eRuntimeError, "Parent of TypeTree node not found.");
+        has_level[n->level] = 1;
+        uint32_t type = reader_u32(r), name = reader_u32(r);
+        n->type = type_tree_string(type, buffer, buffer_size, table);
+        n->name = type_tree_string(name, buffer, buffer_size, table);
+        n->size = (int32_t)reader_u32(r);
+        n->index = reader_u32(r);
+        n->flags = reader_u32(r);
+        n->has_v18meta = version >= 18;
+        if (n->has_v18meta)
+            n->v18meta = reader_u64(r);
+    }
+    r->pos = end_pos;
+    return ret;
+}
+
+static int db_tree_cmp(const void *key, const void *elem) {
+    const DbTree *a = (const DbTree *)key, *b = (const DbTree *)elem;
+    if (a->class_id != b->class_id)
+        return a->class_id < b->class_id ? -1 : 1;
+    return memcmp(a->hash, b->hash, sizeof(a->hash));
+}
+
+static VALUE db_string(uint32_t pos) {
+    return pos == DB_NO_STRING ? Qnil : intern_string(db_strings + pos, strlen(db_strings + pos));
+}
+
+/*
+ * Returns nodes of a TypeTree bundled with the gem (lib/mikunyan/typetrees), which are compiled into the extension
+ *
+ * @param [Integer] rb_class_id class ID
+ * @param [String] rb_hash type hash (16 bytes)
+ * @return [Mikunyan::TypeTree::NodeArray,nil] nodes, or nil if not bundled
+ */
+static VALUE rb_type_tree_default_nodes(VALUE self, VALUE rb_class_id, VALUE rb_hash) {
+    DbTree key = {NUM2INT(rb_class_id), {0}, 0, 0};
+    StringValue(rb_hash);
+    if (RSTRING_LEN(rb_hash) != sizeof(key.hash))
+        return Qnil;
+    memcpy(key.hash, RSTRING_PTR(rb_hash), sizeof(key.hash));
+    const DbTree *tree = bsearch(&key, db_trees, DB_NUM_TREES, sizeof(DbTree), db_tree_cmp);
+    if (!tree)
+        return Qnil;
+
+    NodeArray *a;
+    VALUE ret = new_node_array(tree->count, &a);
+    for (uint32_t i = 0; i < tree->count; i++) {
+        const DbNode *d = db_nodes + tree->first + i;
+        TreeNode *n = a->nodes + i;
+        n->type = db_string(d->type);
+        n->name = db_string(d->name);
+        n->size = d->size;
+        n->v18meta = d->v18meta;
+        n->index = i;
+        n->flags = d->flags;
+        n->version = d->version;
+        n->level = d->level;
+        n->is_array = d->is_array;
+        n->has_v18meta = d->has_v18meta;
+    }
+    return ret;
+}
+
+/*
+ * Get the number of nodes
+ *
+ * @return [Integer] number of nodes
+ */
+static VALUE rb_node_array_size(VALUE self) {
+    return LONG2NUM(get_node_array(self)->count);
+}
+
+/*
+ * Get the type name of the root node
+ *
+ * @return [String,nil] type name
+ */
+static VALUE rb_node_array_type(VALUE self) {
+    const NodeArray *a = get_node_array(self);
+    return a->count > 0 ? a->nodes[0].type : Qnil;
+}
+
+/*
+ * Create Mikunyan::TypeTree::Node linked with their parents and children
+ *
+ * @return [Array<Mikunyan::TypeTree::Node>] nodes
+ */
+static VALUE rb_node_array_to_nodes(VALUE self) {
+    const NodeArray *a = get_node_array(self);
+    VALUE node_class = rb_const_get(rb_path2class("Mikunyan::TypeTree"), rb_intern("Node"));
+    VALUE nodes = rb_ary_new_capa(a->count);
+    VALUE stack[256];
+    for (int i = 0; i < 256; i++)
+        stack[i] = Qnil;
+    for (long i = 0; i < a->count; i++) {
+        const TreeNode *n = a->nodes + i;
+        VALUE node = rb_obj_alloc(node_class);
+        rb_ary_push(nodes, node);
+        rb_struct_aset(node, INT2FIX(NODE_VERSION), INT2FIX(n->version));
+        rb_struct_aset(node, INT2FIX(NODE_LEVEL), INT2FIX(n->level));
+        rb_struct_aset(node, INT2FIX(NODE_ARRAY), n->is_array ? Qtrue : Qfalse);
+        rb_struct_aset(node, INT2FIX(NODE_TYPE), n->type);
+        rb_struct_aset(node, INT2FIX(NODE_NAME), n->name);
+        rb_struct_aset(node, INT2FIX(NODE_SIZE), LONG2NUM(n->size));
+        rb_struct_aset(node, INT2FIX(NODE_INDEX), UINT2NUM(n->index));
+        rb_struct_aset(node, INT2FIX(NODE_FLAGS), UINT2NUM(n->flags));
+        rb_struct_aset(node, INT2FIX(NODE_V18META), n->has_v18meta ? ULL2NUM(n->v18meta) : Qnil);
+        VALUE children = rb_ary_new();
+        rb_struct_aset(node, INT2FIX(NODE_CHILDREN), children);
+        if (n->level > 0) {
+            if (NIL_P(stack[n->level - 1]))
+                rb_raise(rb_eRuntimeError, "Parent of TypeTree node not found.");
+            rb_struct_aset(node, INT2FIX(NODE_PARENT), stack[n->level - 1]);
+            rb_ary_push(rb_struct_aref(stack[n->level - 1], INT2FIX(NODE_CHILDREN)), node);
+        }
+        stack[n->level] = node;
+    }
+    RB_GC_GUARD(nodes);
+    return nodes;
+}
+
+void Init_type_tree(VALUE mMikunyan) {
+    id_children = rb_intern("children");
+    id_flags = rb_intern("flags");
+    id_is_array = rb_intern("array?");
+    id_size = rb_intern("size");
+    id_type = rb_intern("type");
+    id_name = rb_intern("name");
+    id_string_table = rb_intern("STRING_TABLE");
+    id_uminus = rb_intern("-@");
+    VALUE cTypeTree = rb_define_class_under(mMikunyan, "TypeTree", rb_cObject);
+    rb_define_singleton_method(cTypeTree, "load_nodes", rb_type_tree_load_nodes, 2);
+    rb_define_singleton_method(cTypeTree, "default_nodes", rb_type_tree_default_nodes, 2);
+    cNodeArray = rb_define_class_under(cTypeTree, "NodeArray", rb_cObject);
+    rb_undef_alloc_func(cNodeArray);
+    rb_define_method(cNodeArray, "size", rb_node_array_size, 0);
+    rb_define_method(cNodeArray, "type", rb_node_array_type, 0);
+    rb_define_method(cNodeArray, "to_nodes", rb_node_array_to_nodes, 0);
+    rb_define_alias(cNodeArray, "length", "size");
+}
@@ -0,0 +1,37 @@
+#ifndef TYPE_TREE_H
+#define TYPE_TREE_H
+
+#include <ruby.h>
+#include <stdint.h>
+
+/*
+ * Node of TypeTree in a compact array
+ * Nodes are in preorder, and the children of a node are the following nodes one level deeper.
+ */
+typedef struct {
+    VALUE type;
+    VALUE name;
+    long size;
+    uint64_t v18meta;
+    uint32_t index;
+    uint32_t flags;
+    uint16_t version;
+    uint8_t level;
+    uint8_t is_array;
+    uint8_t has_v18meta;
+} TreeNode;
+
+/*
+ * Nodes of TypeTree without Mikunyan::TypeTree::Node
+ * Parsers are compiled from it directly, and Node are created only when they are read.
+ */
+typedef struct {
+    TreeNode *nodes;
+    long count;
+} NodeArray;
+
+NodeArray *get_node_array(VALUE);
+VALUE to_node_array(VALUE);
+void Init_type_tree(VALUE);
+
+#endif /* end of include guard: TYPE_TREE_H */
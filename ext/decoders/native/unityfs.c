@@ -0,0 +1,175 @@
+#include "unityfs.h"
+#include <stdint.h>
+#include <string.h>
+#include "parallel.h"
+#ifdef HAVE_LZMA_H
+#include <lzma.h>
+#endif
+
+// size of the properties (lc/lp/pb and dictionary size) preceding LZMA data
+#define LZMA_PROPS_SIZE 5
+
+extern _Thread_local const char *error_msg;
+
+static inline int lz4_read_length(const uint8_t **ip, const uint8_t *iend, long *len) {
+    unsigned b;
+    do {
+        if (*ip >= iend)
+            return 0;
+        b = *(*ip)++;
+        *len += b;
+    } while (b == 255);
+    return 1;
+}
+
+/*
+ * Decodes an LZ4 block whose decoded size is exactly dest_size
+ * Every length and offset is checked against the buffers, so broken blocks never read or write out of them.
+ */
+static int lz4_decode(const uint8_t *src, const long src_size, uint8_t *dest, const long dest_size) {
+    const uint8_t *ip = src, *const iend = src + src_size;
+    uint8_t *op = dest, *const oend = dest + dest_size;
+    while (ip < iend) {
+        const unsigned token = *ip++;
+        long len = token >> 4;
+        if (len == 15 && !lz4_read_length(&ip, iend, &len))
+            return 0;
+        if (len > iend - ip || len > oend - op)
+            return 0;
+        memcpy(op, ip, len);
+        ip += len;
+        op += len;
+        // the last sequence consists of literals only
+        if (ip == iend)
+            break;
+        if (iend - ip < 2)
+            return 0;
+        const long offset = ip[0] | ip[1] << 8;
+        ip += 2;
+        if (offset == 0 || offset > op - dest)
+            return 0;
+        len = token & 15;
+        if (len == 15 && !lz4_read_length(&ip, iend, &len))
+            return 0;
+        len += 4;
+        if (len > oend - op)
+            return 0;
+        const uint8_t *match = op - offset;
+        if (offset >= 8 && oend - op >= len + 8) {
+            // 8-byte chunks never overlap with what they are copied to if offset >= 8
+            for (long i = 0; i < len; i += 8)
+                memcpy(op + i, match + i, 8);
+            op += len;
+        } else {
+            for (long i = 0; i < len; i++)
+                *op++ = *match++;
+        }
+    }
+    return op == oend;
+}
+
+#ifdef HAVE_LZMA_H
+/*
+ * Decodes an LZMA block (properties followed by raw LZMA1 data, possibly without the end marker)
+ */
+static int lzma_decode(const uint8_t *src, const long src_size, uint8_t *dest, const long dest_size) {
+    if (src_size < LZMA_PROPS_SIZE || src[0] >= 9 * 5 * 5)
+        return 0;
+    lzma_options_lzma options;
+    memset(&options, 0, sizeof(options));
+    options.lc = src[0] % 9;
+    options.lp = src[0] / 9 % 5;
+    options.pb = src[0] / 45;
+    options.dict_size = src[1] | src[2] << 8 | src[3] << 16 | (uint32_t)src[4] << 24;
+    // a dictionary larger than the output is never referenced, so it is not allocated
+    if ((long)options.dict_size > dest_size)
+        options.dict_size = dest_size;
+    if (options.dict_size < LZMA_DICT_SIZE_MIN)
+        options.dict_size = LZMA_DICT_SIZE_MIN;
+    lzma_filter filters[2] = {{LZMA_FILTER_LZMA1, &options}, {LZMA_VLI_UNKNOWN, NULL}};
+    lzma_stream z = LZMA_STREAM_INIT;
+    if (lzma_raw_decoder(&z, filters) != LZMA_OK)
+        return 0;
+    z.next_in = src + LZMA_PROPS_SIZE;
+    z.avail_in = src_size - LZMA_PROPS_SIZE;
+    z.next_out = dest;
+    z.avail_out = dest_size;
+    lzma_ret ret;
+    do {
+        ret = lzma_code(&z, LZMA_RUN);
+    } while (ret == LZMA_OK && z.avail_in > 0 && z.avail_out > 0);
+    lzma_end(&z);
+    return (ret == LZMA_OK || ret == LZMA_STREAM_END) && z.avail_out == 0;
+}
+#endif
+
+/*
+ * Returns whether storage blocks with the flags can be decompressed natively
+ */
+int storage_compression_supported(const int flags) {
+    switch (flags & UNITYFS_COMPRESSION_MASK) {
+    case UNITYFS_COMPRESSION_NONE:
+    case UNITYFS_COMPRESSION_LZ4:
+    case UNITYFS_COMPRESSION_LZ4HC:
+#ifdef HAVE_LZMA_H
+    case UNITYFS_COMPRESSION_LZMA:
+#endif
+        return 1;
+    default:
+        return 0;
+    }
+}
+
+static int decompress_storage_block(const uint8_t *src, uint8_t *dest, const StorageBlock *block) {
+    const uint8_t *s = src + block->src_offset;
+    uint8_t *d = dest + block->dest_offset;
+    switch (block->flags & UNITYFS_COMPRESSION_MASK) {
+    case UNITYFS_COMPRESSION_NONE:
+        if (block->src_size != block->dest_size)
+            break;
+        memcpy(d, s, block->dest_size);
+        return 1;
+    case UNITYFS_COMPRESSION_LZ4:
+    case UNITYFS_COMPRESSION_LZ4HC:
+        if (lz4_decode(s, block->src_size, d, block->dest_size))
+            return 1;
+        error_msg = "Broken LZ4 block.";
+        return 0;
+#ifdef HAVE_LZMA_H
+    case UNITYFS_COMPRESSION_LZMA:
+        if (lzma_decode(s, block->src_size, d, block->dest_size))
+            return 1;
+        error_msg = "Broken LZMA block.";
+        return 0;
+#endif
+    default:
+        error_msg = "Unsupported compression.";
+        return 0;
+    }
+    error_msg = "Broken storage block.";
+    return 0;
+}
+
+typedef struct {
+    const uint8_t *src;
+    uint8_t *dest;
+    const StorageBlock *blocks;
+} StorageJob;
+
+static int decompress_storage_range(void *arg, const long begin, const long end) {
+    const StorageJob *job = (const StorageJob *)arg;
+    for (long i = begin; i < end; i++)
+        if (!decompress_storage_block(job->src, job->dest, job->blocks + i))
+            return 0;
+    return 1;
+}
+
+/*
+ * Decompresses storage blocks of UnityFS into their offsets in dest
+ * Blocks are independent of each other, so they are distributed over decoder threads.
+ * The offsets and sizes must be within src and dest.
+ */
+int decompress_storage_blocks(const uint8_t *src, uint8_t *dest, const StorageBlock *blocks, const long num_blocks) {
+    StorageJob job = {src, dest, blocks};
+    return parallel_for(num_blocks, 1, decompress_storage_range, &job);
+}
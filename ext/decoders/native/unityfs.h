@@ -0,0 +1,24 @@
+#ifndef UNITYFS_H
+#define UNITYFS_H
+
+#include <stdint.h>
+
+#define UNITYFS_COMPRESSION_NONE 0
+#define UNITYFS_COMPRESSION_LZMA 1
+#define UNITYFS_COMPRESSION_LZ4 2
+#define UNITYFS_COMPRESSION_LZ4HC 3
+
+#define UNITYFS_COMPRESSION_MASK 0x3f
+
+typedef struct {
+    long src_offset;
+    long src_size;
+    long dest_offset;
+    long dest_size;
+    int flags;
+} StorageBlock;
+
+int storage_compression_supported(const int);
+int decompress_storage_blocks(const uint8_t *, uint8_t *, const StorageBlock *, const long);
+
+#endif /* end of include guard: UNITYFS_H */
@@ -4,6 +4,7 @@ require 'mikunyan/type_tree'
 require 'mikunyan/constants'
 require 'mikunyan/object_value'
 require 'mikunyan/base_object'
+require 'mikunyan/decoders/native'
 
 module Mikunyan
   # Class for representing Unity Asset
@@ -35,7 +36,7 @@ module Mikunyan
     # @attr [Integer,nil] class_id class ID
     # @attr [Integer,nil] class_idx class definition index
     # @attr [Boolean] destroyed? destroyed or not
-    # @attr [String] data binary data of object
+    # @attr [String] data binary data of object (read when accessed first unless loaded from IO without metadata_only)
     # @attr [Mikunyan::Asset] parent_asset
     # @attr [Klass] klass
     ObjectEntry = Struct.new(
@@ -44,19 +45,25 @@ module Mikunyan
       keyword_init: true
     ) do
       # Alias to {Asset#parse_object}
-      def parse
-        parent_asset.parse_object(self)
+      def parse(fields: nil, lazy: false, packed: false)
+        parent_asset.parse_object(self, fields: fields, lazy: lazy, packed: packed)
       end
 
       # Alias to {Asset#parse_object_simple}
-      def parse_simple
-        parent_asset.parse_object_simple(self)
+      def parse_simple(fields: nil)
+        parent_asset.parse_object_simple(self, fields: fields)
+      end
+
+      # Binary data of the object, which are sliced from the asset when accessed first
+      # @return [String] data
+      def data
+        self[:data] ||= parent_asset.send(:read_object_data, self)
       end
 
       # Returns object type name string
       # @return [String,nil] type name
       def type
-        klass&.type_tree&.tree&.type || Mikunyan::Constants::CLASS_ID2NAME[class_id || klass&.class_id]
+        klass&.type_tree&.type || Mikunyan::Constants::CLASS_ID2NAME[class_id || klass&.class_id]
       end
     end
 
@@ -76,24 +83,39 @@ module Mikunyan
     ContainerInfo = Struct.new(:name, :preload_index, :preload_size, :file_id, :path_id)
 
     # Load Asset from binary string
-    # @param [String,IO] bin binary data
+    # Data of each object are sliced from a String or a MappedFile when they are read first
+    # (see {ObjectEntry#data}), so bin must not be modified while the asset is used.
+    # Object data of a MappedFile are views of the mapped memory, which are not copied.
+    #
+    # If metadata_only is true, only the header and metadata (classes, objects and references) are read,
+    # and data of each object is read from bin when the object is parsed,
+    # so bin must not be closed or modified while the asset is used.
+    # @param [String,IO,Mikunyan::MappedFile,Mikunyan::BlockStream::Slice] bin binary data
     # @param [String] name Asset name
     # @param [Mikunyan::AssetBundle] parent_bundle Parent AssetBundle
+    # @param [Boolean] metadata_only whether object data are not read when loading
     # @return [Mikunyan::Asset] deserialized Asset object
-    def self.load(bin, name, parent_bundle = nil)
+    def self.load(bin, name, parent_bundle = nil, metadata_only: false)
       r = Asset.new(name, parent_bundle)
-      r.send(:load, bin)
+      r.send(:load, bin, metadata_only)
       r
     end
 
     # Load Asset from file
+    # The file is mapped into memory if possible (see {Mikunyan::MappedFile}).
     # @param [String] file file name
     # @param [String] name Asset name (automatically generated if not specified)
+    # @param [Boolean] metadata_only whether object data are not read when loading (needs mmap to parse objects later)
     # @return [Mikunyan::Asset] deserialized Asset object
-    def self.file(file, name = nil)
-      name ||= File.basename(name, '.*')
+    def self.file(file, name = nil, metadata_only: false)
+      name ||= File.basename(file, '.*')
+      return Asset.load(MappedFile.new(file), name, metadata_only: metadata_only) if defined?(MappedFile)
+
       File.open(file, 'rb') do |io|
-        Asset.load(io, name)
+        # the file is closed after loading, so it is not kept to read object data later
+        r = Asset.new(name)
+        r.send(:load, io, metadata_only, false)
+        r
       end
     end
 
@@ -119,7 +141,7 @@ module Mikunyan
     # @return [Array<Hash>,nil] list of all containers
     def containers
       obj = @path_id_table[1]
-      return nil unless obj.klass&.type_tree&.tree&.type == 'AssetBundle'
+      return nil unless obj.klass&.type_tree&.type == 'AssetBundle'
 
       parse_object(obj).m_Container.value.map do |e|
         ContainerInfo.new(e.first.value, e.second.preloadIndex.value, e.second.preloadSize.value,
@@ -128,23 +150,40 @@ module Mikunyan
     end
 
     # Parse object of given path ID
+    #
+    # If fields are given, only the top-level fields with the names are parsed.
+    # Fields before them are skipped by their sizes without being decoded, and fields after them are not read.
+    #
+    # If lazy is true, children of structs are decoded when they are accessed first.
+    # Fields after plain data are found by fixed offsets, and others by skipping the preceding fields.
+    # Arrays are decoded entirely when accessed. {Mikunyan::ObjectValue#attr} and
+    # {Mikunyan::ObjectValue#simplify} decode all the rest.
+    #
+    # If packed is true, arrays of primitives (such as vertices and indices of meshes) have {Mikunyan::PackedArray}
+    # as their values, which keeps the binary data and decodes elements when they are read,
+    # instead of Array of ObjectValue.
     # @param [Integer,ObjectEntry] obj path ID or object
+    # @param [Array<String,Symbol>,nil] fields names of top-level fields to parse (all if nil)
+    # @param [Boolean] lazy whether children are decoded on demand
+    # @param [Boolean] packed whether arrays of primitives are kept packed
     # @return [Mikunyan::BaseObject,nil] parsed object
-    def parse_object(obj)
+    def parse_object(obj, fields: nil, lazy: false, packed: false)
       obj = @path_id_table[obj] if obj.instance_of?(Integer)
       return nil unless obj.klass&.type_tree
 
-      value_klass = Mikunyan::CustomTypes.get_custom_type(obj.klass.type_tree.tree.type, obj.class_id)
-      ret = parse_object_private(BinaryReader.new(obj.data, @endian), obj.klass.type_tree.tree, value_klass)
+      value_klass = Mikunyan::CustomTypes.get_custom_type(obj.klass.type_tree.type, obj.class_id)
+      ret = object_parser(obj.klass).parse(obj.data, @endian, value_klass, self, fields, lazy, packed)
       ret.object_entry = obj
       ret
     end
 
     # Parse object of given path ID and simplify it
     # @param [Integer,ObjectEntry] obj path ID or object
+    # @param [Array<String,Symbol>,nil] fields names of top-level fields to parse (all if nil)
     # @return [Hash,nil] parsed object
-    def parse_object_simple(obj)
-      parse_object(obj)&.simplify
+    def parse_object_simple(obj, fields: nil)
+      # the result is the same, and arrays of primitives are decoded directly into Array
+      parse_object(obj, fields: fields, packed: true)&.simplify
     end
 
     # Returns object type name string
@@ -160,6 +199,40 @@ module Mikunyan
       obj.is_a?(ObjectValue) ? obj.simplify : obj
     end
 
+    @parser_cache = {}
+    @parser_cache_size = 1024
+
+    class << self
+      # Upper limit of the number of parsers in the shared cache (least recently used ones are evicted)
+      # @return [Integer]
+      attr_accessor :parser_cache_size
+    end
+
+    # Compiled parsers shared in the process, keyed by class ID, type hash and the number of nodes,
+    # so that each type is compiled only once across assets and bundles.
+    # Hashes of MonoBehaviour contain the script hash, so the same script type is shared across bundles.
+    # @return [Hash{Array=>Mikunyan::ObjectParser}]
+    def self.parser_cache
+      @parser_cache
+    end
+
+    # Returns the shared parser for key, which is compiled by the block if not cached
+    # @param [Array] key cache key
+    # @yieldreturn [Mikunyan::ObjectParser] compiled parser
+    # @return [Mikunyan::ObjectParser]
+    def self.cached_parser(key)
+      parser = @parser_cache.delete(key) || yield
+      @parser_cache[key] = parser
+      @parser_cache.shift while @parser_cache.size > @parser_cache_size
+      parser
+    end
+
+    # Clears the shared parser cache
+    # Parsers are still kept by loaded assets which use them.
+    def self.clear_parser_cache
+      @parser_cache.clear
+    end
+
     private
 
     # @param [Mikunyan::AssetBundle] bundle
@@ -167,10 +240,19 @@ module Mikunyan
       @name = name
       @endian = :big
       @bundle = bundle
+      @klass_parsers = {}.compare_by_identity
     end
 
-    def load(bin)
-      br = BinaryReader.new(bin)
+    def load(bin, metadata_only, keep_source = true)
+      mapped = bin if defined?(MappedFile) && bin.is_a?(MappedFile)
+      source_pos = bin.is_a?(IO) ? bin.pos : 0
+      # object data are read from the source on demand, except from IO, which may be closed after loading
+      if keep_source && (metadata_only || mapped || bin.is_a?(String))
+        @source = bin
+        @source_pos = source_pos
+      end
+      bin = metadata_part(bin, source_pos) if metadata_only && !mapped
+      br = BinaryReader.new(mapped ? mapped.view : bin)
 
       meta_size = br.i32u
       file_size = br.i32u
@@ -208,6 +290,10 @@ module Mikunyan
         Klass.new(class_id, stripped, script_id, hash, type_tree)
       end
 
+      # classes of objects without class_idx are looked up by ID (the first definition wins as find did)
+      @klass_index = {}
+      @klasses.each {|k| @klass_index[k.class_id] ||= k}
+
       wide_path_id = @format >= 14 || @format >= 7 && br.i32 != 0
 
       object_count = br.i32u
@@ -248,84 +334,70 @@ module Mikunyan
       @comment = br.cstr if @format >= 5
       # _ = br.i32 if @format >= 21
 
+      @data_offset = data_offset
       @objects.each do |e|
-        br.jmp(data_offset + e.offset)
-        e.data = br.read(e.size)
+        if !@source && !metadata_only
+          br.jmp(data_offset + e.offset)
+          e.data = br.read(e.size)
+        end
         e.klass = if e.class_idx
                     @klasses[e.class_idx]
                   else
-                    @klasses.find {|e2| e2.class_id == e.class_id} || @klasses.find {|e2| e2.class_id == e.type_id}
+                    @klass_index[e.class_id] || @klass_index[e.type_id]
                   end
       end
     end
 
-    # @param [Mikunyan::BinaryReader] br
-    # @param [Mikunyan::TypeTree::Node] node
-    def parse_object_private(br, node, klass = ObjectValue)
-      ret = klass.new(node.name, node.type, br.endian)
-      children = node.children
-
-      if children.empty?
-        pos = br.pos
-        ret.value =
-          case node.type
-          when 'bool'
-            br.bool
-          when 'SInt8'
-            br.i8s
-          when 'UInt8'
-            br.i8u
-          when 'SInt16', 'short'
-            br.i16s
-          when 'UInt16', 'unsigned short'
-            br.i16u
-          when 'SInt32', 'int'
-            br.i32s
-          when 'UInt32', 'unsigned int', 'Type*'
-            br.i32u
-          when 'SInt64', 'long long'
-            br.i64s
-          when 'UInt64', 'unsigned long long'
-            br.i64u
-          when 'float'
-            br.float
-          when 'double'
-            br.double
-          else
-            br.read(node.size)
-          end
-        br.jmp(pos + node.size) if node.size >= 0
-      elsif node.array?
-        children.each do |child|
-          next ret[child.name] = parse_object_private(br, child) unless child.name == 'data'
-
-          size = ret['size']&.value || raise('`size` node must appear before `data` node in array node')
-          ret.value =
-            if child.children.empty? && (!child.need_align? || br.pos % 4 == 0 && child.size % 4 == 0)
-              if node.type == 'TypelessData'
-                br.read(size * child.size)
-              elsif child.type == 'char'
-                # string
-                br.read(size * child.size).force_encoding('utf-8')
-              end
-            end
-          ret.value ||= Array.new(size) {parse_object_private(br, child)}
-          ret['data'] = ret.value
-        end
-      elsif children.size == 1 && children[0].array? && children[0].type == 'Array' && children[0].name == 'Array'
-        ret = parse_object_private(br, children[0])
-        ret.name = node.name
-        ret.type = node.type
+    # returns the header and metadata, which precede object data if format >= 9
+    def metadata_part(bin, pos)
+      header = read_head(bin, pos, 48)
+      format = header.unpack1('@8N')
+      return read_head(bin, pos) if format < 9
+
+      data_offset = format >= 22 ? header.unpack1('@32Q>') : header.unpack1('@12N')
+      read_head(bin, pos, data_offset)
+    end
+
+    # reads size bytes (up to the end if nil) from the beginning of the asset at pos of bin
+    def read_head(bin, pos, size = nil)
+      return size ? bin.byteslice(0, size) : bin.to_s if bin.respond_to?(:byteslice)
+
+      bin.pos = pos
+      bin.read(size) || String.new(encoding: Encoding::BINARY)
+    end
+
+    def read_object_data(obj)
+      raise('Object data are not loaded') if !@source || @source.respond_to?(:closed?) && @source.closed?
+
+      offset = @data_offset + obj.offset
+      if defined?(MappedFile) && @source.is_a?(MappedFile)
+        @source.view(offset, obj.size)
+      elsif @source.is_a?(String)
+        BinaryReader.new(@source).read_abs(obj.size, offset)
+      elsif @source.respond_to?(:byteslice)
+        @source.byteslice(offset, obj.size)
+      elsif @source.respond_to?(:pread)
+        @source.pread(obj.size, @source_pos + offset)
       else
-        ret.attr = children.map {|c| [c.name, parse_object_private(br, c)]}.to_h
-        if node.type == 'StreamingInfo'
-          ret.value = get_stream_blob(ret['path'].value, ret['offset'].value, ret['size'].value)
+        @source.pos = @source_pos + offset
+        @source.read(obj.size)
+      end
+    end
+
+    def object_parser(klass)
+      @klass_parsers[klass] ||=
+        if (key = parser_key(klass))
+          Asset.cached_parser(key) {klass.type_tree.parser}
         else
-          ret.is_struct = true
+          klass.type_tree.parser
         end
-      end
-      br.align(4) if node.need_align?
-      ret
+    end
+
+    # hashes can be zero-filled when they are stripped, and then they do not identify types
+    def parser_key(klass)
+      return nil unless klass.hash&.match?(/[^\0]/)
+
+      [klass.class_id, klass.hash, klass.type_tree.node_count]
     end
 
     def get_stream_blob(path, offset, size)
@@ -333,7 +405,7 @@ module Mikunyan
       return nil if path.empty?
 
       path["archive:/#{@name}/"] = '' if path.start_with?("archive:/#{@name}/")
-      @bundle.blobs[path]&.byteslice(offset, size)
+      @bundle.read_blob(path, offset, size)
     end
   end
 end
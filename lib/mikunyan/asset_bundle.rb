@@ -1,9 +1,11 @@
 # frozen_string_literal: true
 
-require 'extlz4'
 require 'extlzma2'
+require 'stringio'
 require 'mikunyan/asset'
 require 'mikunyan/binary_reader'
+require 'mikunyan/block_stream'
+require 'mikunyan/decoders/native'
 
 module Mikunyan
   # Class for representing Unity AssetBundle
@@ -12,46 +14,152 @@ module Mikunyan
   # @attr_reader [String] unity_version version string of Unity for this AssetBundle
   # @attr_reader [String] generator_version version string of generator
   # @attr_reader [String] guid unique identifier (can be zero)
-  # @attr_reader [Array<Mikunyan::Asset>] assets contained Assets
   class AssetBundle
-    attr_reader :signature, :format, :unity_version, :generator_version, :guid, :assets, :blobs
+    attr_reader :signature, :format, :unity_version, :generator_version, :guid
 
+    # Struct for representing an entry in AssetBundle
+    # @attr [String] name entry name
+    # @attr [String,Mikunyan::BlockStream::Slice,Mikunyan::MappedFile] data entry data
+    # @attr [Boolean] blob? whether the entry is not an Asset
+    # @attr [Integer,nil] status flags of the entry (UnityFS only)
     AssetEntry = Struct.new(:name, :data, :blob?, :status, keyword_init: true)
 
+    # Size of the beginning of an IO read for the fixed part of the header
+    HEADER_READ_SIZE = 1024
+
+    # Contained Assets, which are parsed when this method is called first
+    # @return [Array<Mikunyan::Asset>]
+    def assets
+      @assets ||= @entries.reject(&:blob?).map do |e|
+        data = e.data
+        data = data.mapped || (@metadata_only ? data : data.to_s) if data.is_a?(BlockStream::Slice)
+        Asset.load(data, e.name, self, metadata_only: @metadata_only)
+      end
+    end
+
+    # Contained non-Asset files (resource files), which are read entirely when this method is called first
+    # Use {#read_blob} or {#each_chunk} to read a part of them.
+    # @return [Hash{String=>String}]
+    def blobs
+      @blobs ||= @blob_entries.transform_values {|e| e.data.to_s}
+    end
+
+    # Reads a part of a non-Asset file without reading the rest of it
+    # @param [String] name blob name
+    # @param [Integer] offset offset
+    # @param [Integer] size size
+    # @return [String,nil] data, or nil if no such blob exists
+    def read_blob(name, offset, size)
+      data = @blob_entries[name]&.data
+      # a part of String is read without copying
+      return BinaryReader.new(data).read_abs(size, offset) if data.is_a?(String) && offset + size <= data.bytesize
+
+      data&.byteslice(offset, size)
+    end
+
     # @param [String,Integer] index
     # @return [Mikunyan::Asset,nil]
     def [](index)
-      index.is_a?(String) ? @assets.find {|e| e.name == index} : @assets[index]
+      index.is_a?(String) ? assets.find {|e| e.name == index} : assets[index]
     end
 
     # Same as assets.each
     # @return [Enumerator<Mikunyan::Asset>,Array<Mikunyan::Asset>]
     def each_asset(&block)
-      @assets.each(&block)
+      assets.each(&block)
+    end
+
+    # Iterates entries (Assets and blobs) in the bundle without parsing or reading them
+    # @yieldparam [Mikunyan::AssetBundle::AssetEntry] entry entry
+    # @return [Enumerator<Mikunyan::AssetBundle::AssetEntry>,Array<Mikunyan::AssetBundle::AssetEntry>]
+    def each_entry(&block)
+      @entries.each(&block)
+    end
+
+    # Reads an entry chunk by chunk
+    #
+    # Storage blocks of UnityFS are decompressed a few at a time and not cached,
+    # so entries of any size can be written out with constant memory.
+    # @param [String] name entry name
+    # @yieldparam [String] chunk data
+    # @return [Enumerator<String>,nil]
+    def each_chunk(name, &block)
+      entry = @entries.find {|e| e.name == name}
+      raise(ArgumentError, "No such entry: #{name}") unless entry
+      return enum_for(:each_chunk, name) unless block
+
+      data = entry.data
+      data = data.view if mapped? && data.is_a?(MappedFile)
+      data.is_a?(String) ? yield(data) : data.each_chunk(&block)
+      nil
     end
 
     # Loads AssetBundle from binary string
-    # @param [String,IO] bin binary data
+    #
+    # Storage blocks of UnityFS are decompressed only when an entry in them is read,
+    # so bin must not be closed or modified while the bundle is used.
+    # Entries of a MappedFile which are not compressed are used without copying.
+    #
+    # If metadata_only is true, Assets are loaded with only their metadata (see {Mikunyan::Asset.load}),
+    # so only blocks containing the metadata are decompressed until objects are parsed.
+    # @param [String,IO,Mikunyan::MappedFile] bin binary data
+    # @param [Integer] block_cache_size upper limit of the total size of cached decompressed blocks in bytes
+    # @param [Boolean] metadata_only whether object data of Assets are not read when loading
     # @return [Mikunyan::AssetBundle] deserialized AssetBundle object
-    def self.load(bin)
+    def self.load(bin, block_cache_size: BlockStream::DEFAULT_CACHE_SIZE, metadata_only: false)
       r = AssetBundle.new
-      r.send(:load, bin)
+      r.send(:load, bin, block_cache_size, metadata_only)
       r
     end
 
     # Loads AssetBundle from file
+    #
+    # The file is mapped into memory if possible (see {Mikunyan::MappedFile}).
+    # Otherwise it is kept open to read storage blocks lazily until {#close} is called.
+    # If a block is given, the bundle is yielded and closed after the block.
     # @param [String] file file name
-    # @return [Mikunyan::AssetBundle] deserialized AssetBundle object
-    def self.file(file)
-      File.open(file, 'rb') do |io|
-        AssetBundle.load(io)
+    # @param [Integer] block_cache_size upper limit of the total size of cached decompressed blocks in bytes
+    # @param [Boolean] metadata_only whether object data of Assets are not read when loading
+    # @yieldparam [Mikunyan::AssetBundle] bundle deserialized AssetBundle object
+    # @return [Mikunyan::AssetBundle,Object] deserialized AssetBundle object, or the result of the block
+    def self.file(file, block_cache_size: BlockStream::DEFAULT_CACHE_SIZE, metadata_only: false)
+      r = AssetBundle.new
+      r.send(:open_file, file, block_cache_size, metadata_only)
+      return r unless block_given?
+
+      begin
+        yield r
+      ensure
+        r.close
       end
     end
 
+    # Closes the file opened by {AssetBundle.file}
+    # Assets and blobs which have not been read cannot be read after closing.
+    # A mapped file is not closed explicitly; it is released when nothing read from it is referred.
+    def close
+      @io&.close
+    end
+
     private
 
-    def load(bin)
-      br = BinaryReader.new(bin)
+    def open_file(file, block_cache_size, metadata_only)
+      return load(MappedFile.new(file), block_cache_size, metadata_only) if defined?(MappedFile)
+
+      @io = File.open(file, 'rb')
+      load(@io, block_cache_size, metadata_only)
+    rescue StandardError
+      @io&.close
+      raise
+    end
+
+    def load(bin, block_cache_size, metadata_only)
+      @block_cache_size = block_cache_size
+      @metadata_only = metadata_only
+      @source = bin
+      @source_pos = bin.is_a?(String) || mapped? ? 0 : bin.pos
+      # only the fixed part of the header is read from IO, and the rest is read by offsets
+      br = BinaryReader.new(bin.is_a?(String) || mapped? ? read_source(0) : read_source(0, HEADER_READ_SIZE, true))
       @signature = br.cstr
       raise("Invalid signature: #{@signature}") unless @signature.start_with?('Unity')
 
@@ -64,14 +172,16 @@ module Mikunyan
 
     # @param [Mikunyan::BinaryReader] br
     def load_unity_raw(br)
-      @assets = []
-
       _file_size = br.i32u
       header_size = br.i32u
-      br.pos = header_size
-      # この部分全然わからん（ファイルの最後まで読まないとダメらしい?）
-      block = br.read(nil)
-      data = @signature == 'UnityRaw' ? block : uncompress_lzma(block, true)
+      if @signature == 'UnityRaw' && mapped?
+        mapped_data = @source.slice(header_size, @source.bytesize - header_size)
+        data = mapped_data.view
+      else
+        # この部分全然わからん（ファイルの最後まで読まないとダメらしい?）
+        block = read_source(header_size)
+        data = @signature == 'UnityRaw' ? block : uncompress_lzma(block, true)
+      end
       br = BinaryReader.new(data)
 
       asset_count = br.i32u
@@ -80,7 +190,13 @@ module Mikunyan
         offset = br.i32u
         size = br.i32u
         is_asset = ['', '.assets'].include?(split_name(name)[1]) && size > 16
-        AssetEntry.new(name: name, data: br.read_abs(size, offset), blob?: !is_asset)
+        entry_data =
+          if mapped_data
+            is_asset ? mapped_data.slice(offset, size) : mapped_data.view(offset, size)
+          else
+            br.read_abs(size, offset)
+          end
+        AssetEntry.new(name: name, data: entry_data, blob?: !is_asset)
       end
       process_asset_entries(asset_entries)
     end
@@ -96,45 +212,69 @@ module Mikunyan
 
       br.align(16) if @format >= 7
 
-      head_bin = flags & 0x80 == 0 ? br.read(ci_block_size) : br.read_abs(ci_block_size, file_size - ci_block_size)
+      if flags & 0x80 == 0
+        head_bin = read_source(br.pos, ci_block_size)
+        br.adv(ci_block_size)
+      else
+        head_bin = read_source(file_size - ci_block_size, ci_block_size)
+      end
       head = BinaryReader.new(uncompress(head_bin, ui_block_size, flags))
       @guid = head.read(16)
 
       br.align(16) unless flags & 0x200 == 0
 
       block_count = head.i32u
-      raw_data = Array.new(block_count) do
-        u_size = head.i32u
-        c_size = head.i32u
-        flags = head.i16u
-        uncompress(br.read(c_size), u_size, flags)
-      end.join
+      blocks = Array.new(block_count) {[head.i32u, head.i32u, head.i16u]}
+      stream = BlockStream.new(@source, @source_pos + br.pos, blocks, cache_size: @block_cache_size) do |data, size, f|
+        uncompress(data, size, f)
+      end
 
       asset_count = head.i32u
       asset_entries = Array.new(asset_count) do
         offset = head.i64u
         size = head.i64u
         status = head.i32
-        AssetEntry.new(name: head.cstr, data: raw_data.byteslice(offset, size), blob?: status != 4, status: status)
+        AssetEntry.new(name: head.cstr, blob?: status != 4, status: status,
+                       data: stream.slice(offset, size))
       end
       process_asset_entries(asset_entries)
     end
 
     def process_asset_entries(asset_entries)
-      @blobs = asset_entries.select(&:blob?).map {|e| [e.name, e.data]}.to_h
-      @assets = asset_entries.reject(&:blob?).map do |e|
-        Asset.load(e.data, e.name, self)
-      end
+      @entries = asset_entries
+      @blob_entries = asset_entries.select(&:blob?).map {|e| [e.name, e]}.to_h
+    end
+
+    # reads size bytes (up to the end if nil) at offset from the beginning of the bundle
+    def read_source(offset, size = nil, partial = false)
+      ret =
+        if mapped?
+          @source.view(offset, size || @source.bytesize - offset)
+        elsif @source.is_a?(String)
+          @source.byteslice(offset, size || @source.bytesize - offset)
+        else
+          @source.pos = @source_pos + offset
+          @source.read(size)
+        end
+      ret ||= String.new(encoding: Encoding::BINARY)
+      raise EOFError if size && ret.bytesize < size && !partial
+
+      ret
+    end
+
+    def mapped?
+      defined?(MappedFile) && @source.is_a?(MappedFile)
     end
 
     def uncompress(block, max_dest_size, flags)
+      if DecodeHelper::BLOCK_COMPRESSIONS.include?(flags & 0x3f)
+        return DecodeHelper.decompress_blocks(block, [[max_dest_size, block.bytesize, flags]])
+      end
+
       case flags & 0x3f
-      when 0
-        block
       when 1
+        # the native extension is built without liblzma
         uncompress_lzma(block)
-      when 2, 3
-        LZ4.block_decode(block, max_dest_size)
       # when 4
       # LZHMA
       else
@@ -12,7 +12,7 @@ module Mikunyan
     end
 
     def object_name
-      @attr['m_Name']&.value
+      self['m_Name']&.value
     end
   end
 
@@ -0,0 +1,253 @@
+# frozen_string_literal: true
+
+require 'mikunyan/binary_reader'
+
+module Mikunyan
+  # Class for random access to the data part of UnityFS, which consists of compressed storage blocks
+  # Blocks are decompressed only when they are read, and recently used blocks are kept in an LRU cache.
+  # @attr_reader [Integer] size total size of uncompressed data
+  class BlockStream
+    attr_reader :size
+
+    # Default upper limit of the total size of cached blocks
+    DEFAULT_CACHE_SIZE = 64 * 1024 * 1024
+
+    # Struct for representing storage block information
+    # @attr [Integer] offset offset of uncompressed data
+    # @attr [Integer] size uncompressed size
+    # @attr [Integer] source_offset offset of compressed data in source
+    # @attr [Integer] source_size compressed size
+    # @attr [Integer] flags compression flags
+    Block = Struct.new(:offset, :size, :source_offset, :source_size, :flags)
+
+    # Constructor
+    # @param [String,IO] source whole bundle data
+    # @param [Integer] source_offset position of the first block in source
+    # @param [Array<Array(Integer,Integer,Integer)>] blocks uncompressed size, compressed size and flags of each block
+    # @param [Integer] cache_size upper limit of the total size of cached blocks in bytes
+    # @yieldparam [String] data compressed block
+    # @yieldparam [Integer] size uncompressed size
+    # @yieldparam [Integer] flags compression flags
+    # @yieldreturn [String] uncompressed block
+    def initialize(source, source_offset, blocks, cache_size: DEFAULT_CACHE_SIZE, &decompressor)
+      @source = source
+      @decompressor = decompressor
+      @cache_size = cache_size
+      @cache = {}
+      @cache_bytes = 0
+      @mutex = Mutex.new
+      offset = 0
+      @blocks = blocks.map do |u_size, c_size, flags|
+        block = Block.new(offset, u_size, source_offset, c_size, flags)
+        offset += u_size
+        source_offset += c_size
+        block
+      end
+      @size = offset
+    end
+
+    # Reads uncompressed data, decompressing only blocks which overlap with the range
+    # @param [Integer] offset offset
+    # @param [Integer] size size
+    # @return [String] data
+    def read(offset, size)
+      raise EOFError if offset < 0 || size < 0 || offset + size > @size
+      return String.new(encoding: Encoding::BINARY) if size == 0
+
+      index = @blocks.bsearch_index {|b| b.offset + b.size > offset}
+      last = @blocks.bsearch_index {|b| b.offset + b.size >= offset + size}
+      source_offset = uncompressed_offset(index, last, offset)
+      return read_source(source_offset, size) if source_offset
+      return view(block_data(index), offset - @blocks[index].offset, size) if index == last
+
+      # blocks of a long range are decompressed at once into one buffer, in parallel on decoder threads
+      data = decompress_range(index, last)
+      return view(data, offset - @blocks[index].offset, size) if data
+
+      ret = String.new(capacity: size, encoding: Encoding::BINARY)
+      while size > 0
+        block = @blocks[index]
+        len = [block.offset + block.size - offset, size].min
+        ret << block_data(index).byteslice(offset - block.offset, len)
+        offset += len
+        size -= len
+        index += 1
+      end
+      ret
+    end
+
+    # Reads uncompressed data chunk by chunk without caching decompressed blocks
+    # Blocks are decompressed a few at a time (as many as decoder threads), so memory usage does not depend on size.
+    # @param [Integer] offset offset
+    # @param [Integer] size size
+    # @yieldparam [String] chunk data
+    # @return [Enumerator<String>,nil]
+    def each_chunk(offset, size)
+      raise EOFError if offset < 0 || size < 0 || offset + size > @size
+      return enum_for(:each_chunk, offset, size) unless block_given?
+
+      index = @blocks.bsearch_index {|b| b.offset + b.size > offset}
+      end_index = @blocks.bsearch_index {|b| b.offset + b.size >= offset + size}
+      while size > 0
+        last = [index + DecodeHelper.num_threads - 1, end_index].min
+        data = blocks_data(index, last)
+        len = [@blocks[last].offset + @blocks[last].size - offset, size].min
+        start = offset - @blocks[index].offset
+        yield start == 0 && len == data.bytesize ? data : data.byteslice(start, len)
+        offset += len
+        size -= len
+        index = last + 1
+      end
+      nil
+    end
+
+    # Returns a range of the mapped source if it is not compressed
+    # @param [Integer] offset offset
+    # @param [Integer] size size
+    # @return [Mikunyan::MappedFile,nil]
+    def mapped(offset, size)
+      return nil unless defined?(MappedFile) && @source.is_a?(MappedFile) && size > 0
+      raise EOFError if offset < 0 || offset + size > @size
+
+      index = @blocks.bsearch_index {|b| b.offset + b.size > offset}
+      last = @blocks.bsearch_index {|b| b.offset + b.size >= offset + size}
+      source_offset = uncompressed_offset(index, last, offset)
+      source_offset && @source.slice(source_offset, size)
+    end
+
+    # Returns a part of the stream
+    # @param [Integer] offset offset
+    # @param [Integer] size size
+    # @return [Mikunyan::BlockStream::Slice]
+    def slice(offset, size)
+      raise EOFError if offset < 0 || size < 0 || offset + size > @size
+
+      Slice.new(self, offset, size)
+    end
+
+    private
+
+    def block_data(index)
+      @mutex.synchronize do
+        data = @cache.delete(index)
+        unless data
+          data = decompress(@blocks[index])
+          @cache_bytes += data.bytesize
+          # the block being read is always kept even if it exceeds the limit by itself
+          while @cache_bytes > @cache_size && !@cache.empty?
+            _, evicted = @cache.shift
+            @cache_bytes -= evicted.bytesize
+          end
+        end
+        @cache[index] = data
+      end
+    end
+
+    def decompress(block)
+      data = read_source(block.source_offset, block.source_size)
+      data = @decompressor.call(data, block.size, block.flags)
+      raise("Broken storage block at #{block.source_offset}") unless data.bytesize == block.size
+
+      data.freeze
+    end
+
+    # returns the position in source if the blocks are not compressed, where data can be read directly
+    def uncompressed_offset(first, last, offset)
+      return nil unless @blocks[first..last].all? {|b| b.flags & 0x3f == 0 && b.size == b.source_size}
+
+      @blocks[first].source_offset + offset - @blocks[first].offset
+    end
+
+    def decompress_range(first, last)
+      blocks = @blocks[first..last]
+      return nil unless blocks.all? {|b| DecodeHelper::BLOCK_COMPRESSIONS.include?(b.flags & 0x3f)}
+
+      data = read_source(blocks[0].source_offset, blocks.sum(&:source_size))
+      DecodeHelper.decompress_blocks(data, blocks.map {|b| [b.size, b.source_size, b.flags]})
+    end
+
+    # decompresses blocks without caching them
+    def blocks_data(first, last)
+      source_offset = uncompressed_offset(first, last, @blocks[first].offset)
+      return read_source(source_offset, @blocks[first..last].sum(&:size)) if source_offset
+
+      decompress_range(first, last) || (first..last).map {|i| decompress(@blocks[i])}.join
+    end
+
+    # returns a part of decompressed data, which refers to it without copying if large
+    def view(data, offset, size)
+      BinaryReader.new(data).read_abs(size, offset)
+    end
+
+    def read_source(offset, size)
+      ret =
+        if @source.is_a?(String)
+          view(@source, offset, size)
+        elsif @source.respond_to?(:pread)
+          @source.pread(size, offset)
+        else
+          @source.pos = offset
+          @source.read(size)
+        end
+      raise EOFError if ret.nil? || ret.bytesize < size
+
+      ret
+    end
+
+    # Class for representing a part of BlockStream, which can be used like a read-only String
+    # @attr_reader [Integer] bytesize size
+    class Slice
+      attr_reader :bytesize
+      alias size bytesize
+
+      # Constructor
+      # @param [Mikunyan::BlockStream] stream stream
+      # @param [Integer] offset offset in stream
+      # @param [Integer] size size
+      def initialize(stream, offset, size)
+        @stream = stream
+        @offset = offset
+        @bytesize = size
+      end
+
+      # Reads a part of the slice as String#byteslice (integer arguments only)
+      # @param [Integer] start start position (negative for the position from the end)
+      # @param [Integer] length length
+      # @return [String,nil] data
+      def byteslice(start, length = 1)
+        start += @bytesize if start < 0
+        return nil if start < 0 || start > @bytesize || length < 0
+
+        @stream.read(@offset + start, [length, @bytesize - start].min)
+      end
+
+      # Reads the slice chunk by chunk (see {Mikunyan::BlockStream#each_chunk})
+      # @yieldparam [String] chunk data
+      # @return [Enumerator<String>,nil]
+      def each_chunk(&block)
+        @stream.each_chunk(@offset, @bytesize, &block)
+      end
+
+      # Writes the slice to an IO chunk by chunk
+      # @param [IO] io destination
+      # @return [Integer] written size
+      def write_to(io)
+        each_chunk {|chunk| io.write(chunk)}
+        @bytesize
+      end
+
+      # Returns the slice in the mapped source if it is not compressed
+      # @return [Mikunyan::MappedFile,nil]
+      def mapped
+        @stream.mapped(@offset, @bytesize)
+      end
+
+      # Reads the whole slice
+      # @return [String] data
+      def to_s
+        @stream.read(@offset, @bytesize)
+      end
+      alias to_str to_s
+    end
+  end
+end
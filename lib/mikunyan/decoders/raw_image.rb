@@ -0,0 +1,74 @@
+# frozen_string_literal: true
+
+require 'mikunyan/decoders/native'
+
+module Mikunyan
+  module Decoder
+    # Class for decoded pixels which are not converted to ChunkyPNG::Image
+    # @attr_reader [Integer] width image width
+    # @attr_reader [Integer] height image height
+    # @attr_reader [Integer] channels number of channels (3 for RGB or 4 for RGBA)
+    # @attr_reader [String] data pixels (top row first)
+    class RawImage
+      attr_reader :width, :height, :channels, :data
+
+      # PNG filter types
+      FILTERS = {none: 0, sub: 1, up: 2, average: 3, paeth: 4, adaptive: 5}.freeze
+
+      # Constructor
+      # @param [Integer] width image width
+      # @param [Integer] height image height
+      # @param [Integer] channels number of channels (3 for RGB or 4 for RGBA)
+      # @param [String] data pixels (top row first)
+      def initialize(width, height, channels, data)
+        @width = width
+        @height = height
+        @channels = channels
+        @data = data
+      end
+
+      # Crop the image
+      # @param [Integer] x x coordinate of the left edge
+      # @param [Integer] y y coordinate of the top edge
+      # @param [Integer] width width of the cropped image
+      # @param [Integer] height height of the cropped image
+      # @return [Mikunyan::Decoder::RawImage] cropped image
+      def crop(x, y, width, height)
+        unless x >= 0 && y >= 0 && width >= 0 && height >= 0 && x + width <= @width && y + height <= @height
+          raise ArgumentError, 'Cropped area is out of the image'
+        end
+
+        stride = @width * @channels
+        data = String.new(capacity: width * height * @channels, encoding: Encoding::BINARY)
+        height.times {|i| data << @data.byteslice((y + i) * stride + x * @channels, width * @channels)}
+        RawImage.new(width, height, @channels, data)
+      end
+
+      # Encode the image to PNG
+      # @param [Integer,nil] level zlib compression level (0-9, or nil for the default)
+      # @param [Symbol] filter PNG filter type (:none, :sub, :up, :average, :paeth or :adaptive)
+      # @return [String] PNG binary
+      def to_png(level: nil, filter: :adaptive)
+        DecodeHelper.encode_png(@data, @width, @height, @channels, level, FILTERS.fetch(filter))
+      end
+
+      # Save the image as PNG
+      # @param [String] path file path
+      # @param [Integer,nil] level zlib compression level (0-9, or nil for the default)
+      # @param [Symbol] filter PNG filter type (:none, :sub, :up, :average, :paeth or :adaptive)
+      def save(path, level: nil, filter: :adaptive)
+        File.binwrite(path, to_png(level: level, filter: filter))
+      end
+
+      # Convert the image to ChunkyPNG::Image
+      # @return [ChunkyPNG::Image]
+      def to_chunky_png
+        if @channels == 4
+          ChunkyPNG::Image.from_rgba_stream(@width, @height, @data)
+        else
+          ChunkyPNG::Image.from_rgb_stream(@width, @height, @data)
+        end
+      end
+    end
+  end
+end
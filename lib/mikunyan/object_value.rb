@@ -1,7 +1,12 @@
 # frozen_string_literal: true
 
+require 'mikunyan/decoders/native'
+
 module Mikunyan
   # Class for representing decoded object
+  #
+  # A struct parsed lazily (see {Mikunyan::Asset#parse_object}) decodes its children when they are accessed.
+  # An array of primitives may have {Mikunyan::PackedArray} as its value instead of Array.
   # @attr [String] name object name
   # @attr [String] type object type name
   # @attr [Hash<String,Mikunyan::ObjectValue>] attr
@@ -9,7 +14,7 @@ module Mikunyan
   # @attr [Symbol] endian endianness
   # @attr [Boolean] is_struct
   class ObjectValue
-    attr_accessor :name, :type, :attr, :value, :endian, :is_struct
+    attr_accessor :name, :type, :value, :endian, :is_struct
 
     # Constructor
     # @param [String] name object name
@@ -25,16 +30,41 @@ module Mikunyan
       @attr = {}
     end
 
+    # Return all children (which are decoded first if not yet)
+    # @return [Hash<String,Mikunyan::ObjectValue>]
+    def attr
+      materialize
+      @attr
+    end
+
+    # Set children
+    # @param [Hash<String,Mikunyan::ObjectValue>] attr
+    def attr=(attr)
+      @lazy = nil if @lazy
+      @attr = attr
+    end
+
+    # Decodes all children of a lazily parsed struct
+    # Children already accessed are kept as they are.
+    # @return [self]
+    def materialize
+      if @lazy
+        @attr = @lazy.fetch_all(@attr)
+        @lazy = nil
+      end
+      self
+    end
+
     # Return whether object is array or not
     # @return [Boolean]
     def array?
-      value&.is_a?(Array)
+      value.is_a?(Array) || value.is_a?(PackedArray)
     end
 
     # Return whether object is value or not
     # @return [Boolean]
     def value?
-      value && !value.is_a?(Array)
+      value && !array?
     end
 
     # Return whether object is struct or not
@@ -46,14 +76,14 @@ module Mikunyan
     # Return all keys
     # @return [Array] list of keys
     def keys
-      @attr.keys
+      @lazy ? @lazy.keys : @attr.keys
     end
 
     # Return whether object contains key
     # @param [String] key
     # @return [Boolean]
     def key?(key)
-      @attr.key?(key)
+      @lazy ? @lazy.key?(key) : @attr.key?(key)
     end
 
     # Return value of selected index or key
@@ -65,7 +95,7 @@ module Mikunyan
       elsif array? && key.is_a?(Integer)
         @value[key]
       else
-        @attr[key]
+        child(key)
       end
     end
 
@@ -74,6 +104,7 @@ module Mikunyan
     # @param [Object] value value
     # @return [Object] value
     def []=(name, value)
+      materialize
       @attr[name] = value
     end
 
@@ -82,16 +113,17 @@ module Mikunyan
     # @return [Object] value
     def method_missing(name, *args)
       n = name.to_s
-      @attr.key?(n) ? @attr[n] : super
+      key?(n) ? child(n) : super
     end
 
     # Implementation of respond_to_missing?
     def respond_to_missing?(symbol, _include_private)
-      @attr.key?(symbol.to_s)
+      key?(symbol.to_s)
     end
 
     # Simplifies self, or serializes self with ruby primitive types
     def simplify
+      materialize
       if @type == 'pair'
         [@attr['first'].simplify, @attr['second'].simplify]
       elsif @type == 'map' && @value.is_a?(Array)
@@ -100,11 +132,22 @@ module Mikunyan
         @attr.transform_values(&:simplify)
       elsif @value.is_a?(Array)
         @value.map {|e| e.is_a?(ObjectValue) ? e.simplify : e}
+      elsif @value.is_a?(PackedArray)
+        @value.to_a
       elsif @value.is_a?(ObjectValue)
         @value.simplify
       else
         @value
       end
     end
+
+    private
+
+    def child(key)
+      return @attr[key] if !@lazy || @attr.key?(key)
+
+      value = @lazy.fetch(key)
+      value ? @attr[key] = value : nil
+    end
   end
 end
@@ -1,13 +1,16 @@
 # frozen_string_literal: true
 
-require 'json'
 require 'mikunyan/binary_reader'
+require 'mikunyan/decoders/native'
 
 module Mikunyan
   # Class for representing TypeTree
   # @attr [Array<Mikunyan::TypeTree::Node>] nodes list of all nodes
+  # @attr [Mikunyan::TypeTree::NodeArray,nil] node_array compact nodes read natively, from which nodes are created
+  #   when they are read first
   class TypeTree
-    attr_accessor :nodes
+    attr_writer :nodes
+    attr_accessor :node_array
 
     # Struct for representing Node in TypeTree
     # @attr [String] version version string
@@ -27,12 +30,35 @@ module Mikunyan
       end
     end
 
+    def nodes
+      @nodes ||= @node_array&.to_nodes
+    end
+
     # Returns the root node of the typetree
     # @return [Mikunyan::TypeTree::Node,nil]
     def tree
       nodes&.[](0)
     end
 
+    # Returns the type name of the root node without creating nodes
+    # @return [String,nil]
+    def type
+      @nodes || !@node_array ? tree&.type : @node_array.type
+    end
+
+    # Returns the number of nodes without creating them
+    # @return [Integer]
+    def node_count
+      @nodes || !@node_array ? nodes&.size.to_i : @node_array.size
+    end
+
+    # Returns the parser compiled from the typetree, which is compiled when this method is called first
+    # The parser does not follow changes of nodes after it is compiled.
+    # @return [Mikunyan::ObjectParser]
+    def parser
+      @parser ||= ObjectParser.new(@nodes || !@node_array ? tree : @node_array)
+    end
+
     # Generates JSON-compatible serialized representation of typetree information
     def serialize
       {
@@ -57,34 +83,10 @@ module Mikunyan
     # @param [Integer] version asset format version
     # @return [Mikunyan::TypeTree] created TypeTree
     def self.load(br, version)
+      ret = TypeTree.new
       if version == 10 || version >= 12
-        node_count = br.i32u
-        buffer_size = br.i32u
-        nodes = Array.new(node_count) do
-          Node.new(
-            version: br.i16u,
-            level: br.i8u,
-            array?: br.bool,
-            type: br.i32u,
-            name: br.i32u,
-            size: br.i32s,
-            index: br.i32u,
-            flags: br.i32u,
-            v18meta: version >= 18 ? br.i64u : nil,
-            children: []
-          )
-        end
-        buffer = br.read(buffer_size)
-        stack = []
-        nodes.each do |n|
-          n.type = Mikunyan::Constants.get_string_or_default(n.type, buffer)
-          n.name = Mikunyan::Constants.get_string_or_default(n.name, buffer)
-          if n.level > 0
-            n.parent = stack[n.level - 1]
-            n.parent.children << n
-          end
-          stack[n.level] = n
-        end
+        # read natively into a compact array (see TypeTree.load_nodes)
+        ret.node_array = load_nodes(br, version)
         br.adv(4) if version >= 21
       else
         nodes = []
@@ -107,21 +109,31 @@ module Mikunyan
           parent.children << node if parent
           stack += Array.new(br.i32u, node)
         end
+        ret.nodes = nodes
       end
-      ret = TypeTree.new
-      ret.nodes = nodes
       ret
     end
 
+    @default_cache = {}
+
     # Create default TypeTree from hash string (if exists)
+    #
+    # The bundled TypeTrees (lib/mikunyan/typetrees) are compiled into the native extension
+    # when it is built (see TypeTree.default_nodes).
+    # Each TypeTree is read once in the process and shared by all assets (as well as its parser),
+    # so it should not be modified. Misses are not cached, since hashes of unknown types are unbounded.
     # @param [Integer] class_id
     # @param [String] hash
     # @return [Mikunyan::TypeTree,nil] created TypeTree
     def self.load_default(class_id, hash)
-      file = File.expand_path("../typetrees/#{class_id}/#{hash.unpack1('H*')}.json", __FILE__)
-      return nil unless File.file?(file)
+      key = [class_id, hash]
+      cached = @default_cache[key]
+      return cached if cached
+
+      node_array = default_nodes(class_id, hash)
+      return nil unless node_array
 
-      TypeTree.deserialize(JSON.parse(File.read(file)))
+      @default_cache[key] = TypeTree.new.tap {|e| e.node_array = node_array}
     end
 
     # Creates TypeTree from serialized object
@@ -8,11 +8,11 @@ module Mikunyan
       Mikunyan::CustomTypes.set_custom_type(self, 'TextAsset')
 
       def text
-        @attr['m_Script']&.value
+        self['m_Script']&.value
       end
 
       def bytes
-        @attr['m_Script']&.value.dup.force_encoding('ASCII-8BIT')
+        self['m_Script']&.value.dup.force_encoding('ASCII-8BIT')
       end
     end
   end
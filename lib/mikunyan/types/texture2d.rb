@@ -13,20 +13,26 @@ module Mikunyan
         Mikunyan::Decoder::ImageDecoder.decode_object(self)
       end
 
+      # Decodes the texture data into raw pixels (an instance of {Decoder::RawImage}), which can be saved as PNG
+      # without being converted to {ChunkyPNG::Image}
+      def generate_raw_image
+        Mikunyan::Decoder::ImageDecoder.decode_object(self, raw: true)
+      end
+
       def width
-        @attr['m_Width']&.value
+        self['m_Width']&.value
       end
 
       def height
-        @attr['m_Height']&.value
+        self['m_Height']&.value
       end
 
       def texture_format
-        @attr['m_TextureFormat']&.value
+        self['m_TextureFormat']&.value
       end
 
       def mipmap_count
-        @attr['m_MipCount']&.value
+        self['m_MipCount']&.value
       end
     end
   end
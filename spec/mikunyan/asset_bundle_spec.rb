@@ -0,0 +1,52 @@
+# frozen_string_literal: true
+
+RSpec.describe Mikunyan::AssetBundle do
+  entries = Fixtures.bundle_entries(Fixtures.asset)
+  bundles = {
+    'UnityFS without compression' => -> {Fixtures.unity_fs(entries, compression: :none)},
+    'UnityFS with LZ4' => -> {Fixtures.unity_fs(entries, compression: :lz4)},
+    'UnityFS with LZMA' => lambda do
+      entries = Fixtures.bundle_entries(Fixtures.asset(format: 22))
+      Fixtures.unity_fs(entries, compression: :lzma, format: 7, block_size: 1 << 20)
+    end,
+    'UnityRaw' => -> {Fixtures.unity_raw(entries)}
+  }
+
+  bundles.each do |description, build|
+    context "with #{description}" do
+      let(:bundle) {described_class.load(build.())}
+      let(:asset) {bundle.assets[0]}
+
+      it 'reads the entries' do
+        expect(bundle.assets.map(&:name)).to eq([Fixtures::ASSET_NAME])
+        expect(bundle.blobs).to eq(Fixtures::BLOB_NAME => Fixtures::BLOB)
+        expect(bundle.read_blob(Fixtures::BLOB_NAME, 10, 20)).to eq(Fixtures::BLOB.byteslice(10, 20))
+      end
+
+      it 'parses the objects' do
+        asset.path_ids.each do |id|
+          expect(asset.parse_object(id).simplify).to eq(Fixtures.values(id))
+        end
+      end
+
+      it 'reads the blobs of StreamingInfo' do
+        expect(asset.parse_object(2, lazy: true).m_StreamData.value).to eq(Fixtures.values(2)['m_StreamData'])
+        expect(asset.parse_object(3, fields: ['m_StreamData']).m_StreamData.value)
+          .to eq(Fixtures.values(3)['m_StreamData'])
+      end
+    end
+  end
+
+  it 'decompresses blocks on multiple threads' do
+    data = Fixtures.unity_fs(entries, compression: :lz4, block_size: 100)
+    threads = Mikunyan::DecodeHelper.num_threads
+    begin
+      Mikunyan::DecodeHelper.num_threads = 4
+      bundle = described_class.load(data)
+      expect(bundle.blobs[Fixtures::BLOB_NAME]).to eq(Fixtures::BLOB)
+      expect(bundle.assets[0].parse_object(3).simplify).to eq(Fixtures.values(3))
+    ensure
+      Mikunyan::DecodeHelper.num_threads = threads
+    end
+  end
+end
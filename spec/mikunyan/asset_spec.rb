@@ -0,0 +1,121 @@
+# frozen_string_literal: true
+
+RSpec.describe Mikunyan::Asset do
+  [[17, :little], [17, :big], [22, :little]].each do |format, endian|
+    context "with format #{format} in #{endian} endian" do
+      let(:asset) {described_class.load(Fixtures.asset(format: format, endian: endian), Fixtures::ASSET_NAME)}
+
+      it 'reads the metadata' do
+        expect(asset.format).to eq(format)
+        expect(asset.endian).to eq(endian)
+        expect(asset.path_ids).to eq([1, 2, 3])
+        expect(asset.objects.map(&:type)).to all(eq('SpecObject'))
+      end
+
+      describe '#parse_object' do
+        let(:obj) {asset.parse_object(2)}
+
+        it 'reads the fields following aligned ones' do
+          expect(obj.m_Enabled.value).to be(false)
+          expect(obj.m_Value.value).to eq(-2007)
+          expect(obj.m_Pair.simplify).to eq([1.5, 2e10])
+        end
+
+        it 'reads strings and TypelessData at once' do
+          expect(obj.m_Name.value).to eq('object2')
+          expect(obj.m_Name.value.encoding).to eq(Encoding::UTF_8)
+          expect(obj.m_Bytes.value).to eq(Fixtures.values(2)['m_Bytes'])
+          expect(obj.m_Bytes.value.encoding).to eq(Encoding::BINARY)
+        end
+
+        it 'unwraps Array of vectors' do
+          expect(obj.m_List.type).to eq('vector')
+          expect(obj.m_List.name).to eq('m_List')
+          expect(obj.m_List.value.map(&:value)).to eq([2, -2, 302])
+          expect(obj.m_List[2].value).to eq(302)
+        end
+
+        it 'has no blob of StreamingInfo without bundle' do
+          expect(obj.m_StreamData.value).to be_nil
+          expect(obj.m_StreamData.offset.value).to eq(200)
+        end
+
+        it 'is simplified into the values' do
+          expect(obj.simplify).to eq(Fixtures.values(2).merge('m_StreamData' => nil))
+        end
+
+        it 'creates the root of the custom type' do
+          expect(obj).to be_a(Mikunyan::BaseObject)
+          expect(obj.object_entry).to eq(asset.objects[1])
+        end
+
+        it 'calls initialize of the root class' do
+          klass = Class.new(Mikunyan::BaseObject) do
+            attr_reader :args
+
+            def initialize(*args)
+              super
+              @args = args
+            end
+          end
+          entry = asset.objects[0]
+          [{}, {lazy: true}, {fields: ['m_Value']}].each do |options|
+            obj = entry.klass.type_tree.parser.parse(entry.data, endian, klass, asset, options[:fields], options[:lazy])
+            expect(obj.args).to eq(['Base', 'SpecObject', endian])
+            expect(obj.m_Value.value).to eq(-1007)
+          end
+        end
+      end
+
+      describe 'fields' do
+        it 'parses only the selected fields' do
+          obj = asset.parse_object(3, fields: %w[m_Value m_List])
+          expect(obj.keys).to eq(%w[m_Value m_List])
+          expect(obj.m_List.simplify).to eq([3, -3, 303])
+        end
+
+        it 'accepts symbols' do
+          expect(asset.parse_object(3, fields: [:m_Pair]).simplify).to eq('m_Pair' => [1.5, 3e10])
+        end
+
+        it 'returns the same values as the full parse' do
+          full = asset.parse_object(1).simplify
+          expect(asset.parse_object(1, fields: %w[m_Name m_Floats]).simplify).to eq(full.slice('m_Name', 'm_Floats'))
+        end
+      end
+
+      describe 'lazy' do
+        it 'returns the same values as the eager parse' do
+          asset.path_ids.each do |id|
+            expect(asset.parse_object(id, lazy: true).simplify).to eq(asset.parse_object(id).simplify)
+          end
+        end
+
+        it 'decodes the fields in any order' do
+          obj = asset.parse_object(1, lazy: true)
+          expect(obj.keys).to eq(Fixtures.values(1).keys)
+          expect(obj.m_Pair.first.value).to eq(1.5)
+          expect(obj.m_Value.value).to eq(-1007)
+          expect(obj.key?('m_Missing')).to be(false)
+        end
+      end
+
+      describe 'packed' do
+        let(:obj) {asset.parse_object(1, packed: true)}
+
+        it 'keeps arrays of primitives packed' do
+          expect(obj.m_List.value).to be_a(Mikunyan::PackedArray)
+          expect(obj.m_List.value.to_a).to eq([1, -1, 301])
+          expect(obj.m_Floats.value.type).to eq('float')
+          expect(obj.m_Floats.value.endian).to eq(endian)
+          expect(obj.m_Floats.value[1]).to eq(-1.25)
+        end
+
+        it 'returns the same values as the unpacked parse' do
+          expect(obj.simplify).to eq(asset.parse_object(1).simplify)
+          expect(asset.parse_object_simple(1)).to eq(asset.parse_object(1).simplify)
+        end
+      end
+    end
+  end
+end
@@ -0,0 +1,37 @@
+# frozen_string_literal: true
+
+RSpec.describe Mikunyan::DecodeHelper do
+  around do |example|
+    threads = described_class.num_threads
+    example.run
+  ensure
+    described_class.num_threads = threads
+  end
+
+  describe '.num_threads=' do
+    it 'uses all processors with 0' do
+      described_class.num_threads = 0
+      expect(described_class.num_threads).to be >= 1
+    end
+  end
+
+  # rows of 1024 blocks are distributed one by one, so images of a few rows leave some threads without rows
+  width = 4096
+  {decode_etc2: [8], decode_eacr: [8], decode_dxt5: [16], decode_astc: [16, 4, 4]}.each do |method, (block_size, *args)|
+    describe ".#{method}" do
+      it 'decodes images of any number of block rows in the same way on any number of threads' do
+        (1..13).each do |rows|
+          data = Random.new(rows).bytes(width / 4 * rows * block_size)
+          [rows * 4, rows * 4 - 3].each do |height|
+            described_class.num_threads = 1
+            expected = described_class.send(method, data, width, height, *args)
+            [2, 3, 4, 7, 8].each do |threads|
+              described_class.num_threads = threads
+              expect(described_class.send(method, data, width, height, *args)).to eq(expected)
+            end
+          end
+        end
+      end
+    end
+  end
+end
@@ -0,0 +1,13 @@
+# frozen_string_literal: true
+
+require 'mikunyan'
+require_relative 'support/fixtures'
+
+RSpec.configure do |config|
+  config.expect_with :rspec do |c|
+    c.syntax = :expect
+  end
+  config.disable_monkey_patching!
+  config.order = :random
+  Kernel.srand config.seed
+end
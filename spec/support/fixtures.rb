@@ -0,0 +1,243 @@
+# frozen_string_literal: true
+
+require 'extlzma2'
+
+# Builds small assets and bundles of a synthetic class (SpecObject) for specs
+module Fixtures
+  ALIGN = 0x4000
+
+  # Nodes of SpecObject (level, type, name, size, flags, array?)
+  NODES = [
+    [0, 'SpecObject', 'Base', -1, 0, false],
+    [1, 'string', 'm_Name', -1, ALIGN, false],
+    [2, 'Array', 'Array', -1, ALIGN, true],
+    [3, 'int', 'size', 4, 0, false],
+    [3, 'char', 'data', 1, 0, false],
+    [1, 'bool', 'm_Enabled', 1, ALIGN, false],
+    [1, 'int', 'm_Value', 4, 0, false],
+    [1, 'TypelessData', 'm_Bytes', -1, ALIGN, true],
+    [2, 'int', 'size', 4, 0, false],
+    [2, 'UInt8', 'data', 1, 0, false],
+    [1, 'vector', 'm_List', -1, ALIGN, false],
+    [2, 'Array', 'Array', -1, 0, true],
+    [3, 'int', 'size', 4, 0, false],
+    [3, 'SInt16', 'data', 2, 0, false],
+    [1, 'vector', 'm_Floats', -1, 0, false],
+    [2, 'Array', 'Array', -1, 0, true],
+    [3, 'int', 'size', 4, 0, false],
+    [3, 'float', 'data', 4, 0, false],
+    [1, 'pair', 'm_Pair', -1, 0, false],
+    [2, 'float', 'first', 4, 0, false],
+    [2, 'double', 'second', 8, 0, false],
+    [1, 'StreamingInfo', 'm_StreamData', -1, 0, false],
+    [2, 'UInt64', 'offset', 8, 0, false],
+    [2, 'unsigned int', 'size', 4, 0, false],
+    [2, 'string', 'path', -1, ALIGN, false],
+    [3, 'Array', 'Array', -1, ALIGN, true],
+    [4, 'int', 'size', 4, 0, false],
+    [4, 'char', 'data', 1, 0, false]
+  ].freeze
+
+  CLASS_ID = 1000
+  TYPE_HASH = (1..16).to_a.pack('C*').freeze
+  ASSET_NAME = 'CAB-spec'
+  BLOB_NAME = 'CAB-spec.resS'
+  BLOB = Random.new(1).bytes(5000).freeze
+  NUM_OBJECTS = 3
+
+  # Writer of binary data
+  class Writer
+    attr_reader :data
+
+    def initialize(endian = :little)
+      @data = String.new(encoding: Encoding::BINARY)
+      @suffix = endian == :little ? '<' : '>'
+    end
+
+    def pos
+      @data.bytesize
+    end
+
+    def raw(str)
+      @data << str.b
+      self
+    end
+
+    def u8(value)
+      raw([value].pack('C'))
+    end
+
+    {i16: 's', u16: 'S', i32: 'l', u32: 'L', i64: 'q', u64: 'Q'}.each do |name, directive|
+      define_method(name) {|value| raw([value].pack("#{directive}#{@suffix}"))}
+    end
+
+    def f32(value)
+      raw([value].pack(@suffix == '<' ? 'e' : 'g'))
+    end
+
+    def f64(value)
+      raw([value].pack(@suffix == '<' ? 'E' : 'G'))
+    end
+
+    def cstr(str)
+      raw("#{str}\0")
+    end
+
+    def align(size)
+      raw("\0" * (-pos % size))
+    end
+
+    def string(str)
+      i32(str.bytesize)
+      raw(str)
+      align(4)
+    end
+  end
+
+  module_function
+
+  # Values of the i-th object in the simplified form
+  def values(index)
+    {
+      'm_Name' => "object#{index}",
+      'm_Enabled' => index.odd?,
+      'm_Value' => -1000 * index - 7,
+      'm_Bytes' => Random.new(index).bytes(5 * index + 3),
+      'm_List' => [index, -index, 300 + index],
+      'm_Floats' => [0.5 * index, -1.25],
+      'm_Pair' => [1.5, index * 1e10],
+      'm_StreamData' => BLOB.byteslice(100 * index, 50 + index)
+    }
+  end
+
+  def object_data(index, endian)
+    v = values(index)
+    w = Writer.new(endian)
+    w.string(v['m_Name'])
+    w.u8(v['m_Enabled'] ? 1 : 0).align(4)
+    w.i32(v['m_Value'])
+    w.i32(v['m_Bytes'].bytesize).raw(v['m_Bytes']).align(4)
+    w.i32(v['m_List'].size)
+    v['m_List'].each {|e| w.i16(e)}
+    w.align(4)
+    w.i32(v['m_Floats'].size)
+    v['m_Floats'].each {|e| w.f32(e)}
+    w.f32(v['m_Pair'][0]).f64(v['m_Pair'][1])
+    w.u64(100 * index).u32(50 + index).string("archive:/#{ASSET_NAME}/#{BLOB_NAME}")
+    w.data
+  end
+
+  def write_type_tree(w, format)
+    buffer = String.new(encoding: Encoding::BINARY)
+    offsets = {}
+    offset = ->(str) {offsets[str] ||= buffer.bytesize.tap {buffer << str << "\0"}}
+    strings = NODES.map {|n| [offset.(n[1]), offset.(n[2])]}
+    w.u32(NODES.size).u32(buffer.bytesize)
+    NODES.each_with_index do |(level, _, _, size, flags, array), i|
+      w.u16(1).u8(level).u8(array ? 1 : 0).u32(strings[i][0]).u32(strings[i][1]).i32(size).u32(i).u32(flags)
+      w.u64(0) if format >= 18
+    end
+    w.raw(buffer)
+    w.u32(0) if format >= 21
+  end
+
+  # Builds an asset of NUM_OBJECTS objects (format 17 or 22)
+  def asset(format: 17, endian: :little)
+    m = Writer.new(endian)
+    m.cstr('2019.4.0f1').i32(13).u8(1).u32(1)
+    m.i32(CLASS_ID).u8(0).i16(-1).raw(TYPE_HASH)
+    write_type_tree(m, format)
+    objects = Array.new(NUM_OBJECTS) {|i| object_data(i + 1, endian)}
+    m.u32(objects.size)
+    offset = 0
+    objects.each_with_index do |data, i|
+      m.align(4).i64(i + 1)
+      format >= 22 ? m.u64(offset) : m.u32(offset)
+      m.u32(data.bytesize).u32(0)
+      offset += (data.bytesize + 7) / 8 * 8
+    end
+    m.u32(0).u32(0).cstr('')
+
+    header_size = format >= 22 ? 48 : 20
+    data_offset = (header_size + m.pos + 15) / 16 * 16
+    body = Writer.new
+    objects.each {|data| body.align(8).raw(data)}
+    h = Writer.new(:big)
+    if format >= 22
+      h.u32(0).u32(0).u32(format).u32(0).u8(endian == :big ? 1 : 0).raw("\0" * 3)
+      h.u32(m.pos).u64(data_offset + body.pos).u64(data_offset).u64(0)
+    else
+      h.u32(m.pos).u32(data_offset + body.pos).u32(format).u32(data_offset).u8(endian == :big ? 1 : 0).raw("\0" * 3)
+    end
+    h.raw(m.data).align(16).raw(body.data).data
+  end
+
+  # LZ4 block of literals only (which is valid without any match)
+  def lz4(data)
+    len = data.bytesize
+    return [len << 4].pack('C') + data if len < 15
+
+    rest = len - 15
+    [0xf0].pack('C') + ("\xff".b * (rest / 255)) + [rest % 255].pack('C') + data
+  end
+
+  def lzma(data)
+    dictsize = 1 << 16
+    filter = LZMA.lzma1(dictsize: dictsize, lc: 3, lp: 0, pb: 2)
+    [(2 * 5 + 0) * 9 + 3, dictsize].pack('CV') + LZMA.raw_encode(data, filter)
+  end
+
+  def compress(data, compression)
+    case compression
+    when :lzma then lzma(data)
+    when :lz4 then lz4(data)
+    else data
+    end
+  end
+
+  # Builds a UnityFS bundle of the entries ([name, data, flags])
+  def unity_fs(entries, compression:, format: 6, block_size: 1024)
+    flags = {none: 0, lzma: 1, lz4: 2}.fetch(compression)
+    data = entries.map {|e| e[1]}.join.b
+    blocks = (0...data.bytesize).step(block_size).map do |pos|
+      chunk = data.byteslice(pos, block_size)
+      [chunk.bytesize, compress(chunk, compression)]
+    end
+    head = Writer.new(:big).raw("\0" * 16).i32(blocks.size)
+    blocks.each {|size, block| head.u32(size).u32(block.bytesize).u16(flags)}
+    head.i32(entries.size)
+    offset = 0
+    entries.each do |name, entry, entry_flags|
+      head.i64(offset).i64(entry.bytesize).i32(entry_flags).cstr(name)
+      offset += entry.bytesize
+    end
+    head_data = compress(head.data, compression)
+
+    w = Writer.new(:big).cstr('UnityFS').i32(format).cstr('5.x.x').cstr('2019.4.0f1')
+    size_pos = w.pos
+    w.i64(0).u32(head_data.bytesize).u32(head.pos).u32(flags | 0x40)
+    w.align(16) if format >= 7
+    w.raw(head_data)
+    blocks.each {|_, block| w.raw(block)}
+    w.data[size_pos, 8] = [w.pos].pack('Q>')
+    w.data
+  end
+
+  # Builds an uncompressed UnityRaw bundle of the entries ([name, data])
+  def unity_raw(entries)
+    w = Writer.new(:big).cstr('UnityRaw').i32(3).cstr('5.x.x').cstr('2019.4.0f1').u32(0)
+    w.u32(w.pos + 4)
+    w.u32(entries.size)
+    offset = entries.sum {|name, _| name.bytesize + 9} + 4
+    entries.each do |name, data|
+      w.cstr(name).u32(offset).u32(data.bytesize)
+      offset += data.bytesize
+    end
+    entries.each {|_, data| w.raw(data)}
+    w.data
+  end
+
+  def bundle_entries(asset_data)
+    [[ASSET_NAME, asset_data, 4], [BLOB_NAME, BLOB, 0]]
+  end
+end